@@ -0,0 +1,447 @@
+/*
+* Node Web Bluetooth
+* Copyright (c) 2026 Rob Moran
+*
+* The MIT License (MIT)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+// Benchmarks the native binding against the simulated backend, build it with
+// `yarn build:sim && yarn build:ts` then run
+// `yarn bench [--output file] [--baseline file] [name...]`. Results are written
+// as JSON so releases can be compared, a baseline report adds the change of
+// every number against it.
+
+const { readFileSync, writeFileSync } = require('fs');
+const { performance } = require('perf_hooks');
+const simpleble = require('../dist/adapters/simpleble');
+const { version } = require('../package.json');
+
+const SERVICE = '0000fff0-0000-1000-8000-00805f9b34fb';
+const ADDRESS = 'C0:FF:EE:00:00:01';
+
+const characteristic = index => `0000ff${(index + 1).toString(16).padStart(2, '0')}-0000-1000-8000-00805f9b34fb`;
+const sleep = ms => new Promise(resolve => setTimeout(resolve, ms));
+const now = () => performance.timeOrigin + performance.now();
+
+const percentile = (sorted, p) => sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))] : 0;
+const round = value => Math.round(value * 1000) / 1000;
+
+// Bytes of JS heap and ArrayBuffer memory allocated per operation. Needs
+// --expose-gc and a young generation big enough that no scavenge runs while
+// measuring, which the bench script sets.
+const allocation = async (count, run) => {
+    if (global.gc) {
+        global.gc();
+    }
+    const before = process.memoryUsage();
+    await run();
+    const after = process.memoryUsage();
+    return {
+        heapBytesPerOp: round(Math.max(0, after.heapUsed - before.heapUsed) / count),
+        arrayBufferBytesPerOp: round(Math.max(0, after.arrayBuffers - before.arrayBuffers) / count)
+    };
+};
+
+const scanFor = (adapter, address) => new Promise(resolve => {
+    adapter.setCallbackOnScanFound(peripheral => {
+        if (peripheral.address === address) {
+            adapter.scanStop();
+            resolve(peripheral);
+        }
+    });
+    adapter.scanStart();
+});
+
+const connected = async config => {
+    simpleble.simulator.configure({ peripherals: [{ identifier: 'Benchmark', address: ADDRESS, advertisingInterval: 1, ...config }] });
+    const adapter = simpleble.getAdapters()[0];
+    const peripheral = await scanFor(adapter, ADDRESS);
+    if (!peripheral.connect()) {
+        throw new Error('Connect failed');
+    }
+    return { adapter, peripheral };
+};
+
+const benchmarks = {
+    // Found events for a crowd of advertisers, then the sustained update rate
+    // with every advertiser repeating every 2ms
+    async scan() {
+        const count = 2000;
+        simpleble.simulator.configure({
+            peripherals: [{ count, identifier: 'Advertiser', address: '00:00:00:00:00:00', advertisingInterval: 2 }]
+        });
+        const adapter = simpleble.getAdapters()[0];
+
+        let found = 0;
+        let updated = 0;
+        const start = now();
+        const allFound = new Promise(resolve => {
+            adapter.setCallbackOnScanFound(() => {
+                if (++found === count) {
+                    resolve(now());
+                }
+            });
+        });
+        adapter.setCallbackOnScanUpdated(() => updated++);
+        adapter.scanStart();
+        const foundAt = await allFound;
+
+        updated = 0;
+        const updatedStart = now();
+        const alloc = await allocation(1, () => sleep(1000));
+        const updatedCount = updated;
+        const elapsed = (now() - updatedStart) / 1000;
+        adapter.scanStop();
+
+        return {
+            found: { count, eventsPerSec: round(count / ((foundAt - start) / 1000)) },
+            updated: {
+                count: updatedCount,
+                eventsPerSec: round(updatedCount / elapsed),
+                heapBytesPerOp: round(alloc.heapBytesPerOp / Math.max(updatedCount, 1)),
+                arrayBufferBytesPerOp: round(alloc.arrayBufferBytesPerOp / Math.max(updatedCount, 1))
+            },
+            stats: adapter.scanStats()
+        };
+    },
+
+    // Sixteen characteristics notifying every millisecond, latency from the
+    // simulated send to the JS callback
+    async notify() {
+        const characteristics = 16;
+        const count = 20000;
+        const { peripheral } = await connected({
+            services: [{
+                uuid: SERVICE,
+                characteristics: Array.from({ length: characteristics }, (_, i) => ({
+                    uuid: characteristic(i), canNotify: true, notifyInterval: 1, notifyLength: 20
+                }))
+            }]
+        });
+
+        const latencies = new Float64Array(count);
+        let received = 0;
+        let start;
+        const done = new Promise(resolve => {
+            const onNotify = data => {
+                if (received < count) {
+                    const view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+                    latencies[received++] = now() - view.getFloat64(4, true);
+                    if (received === count) {
+                        resolve(now());
+                    }
+                }
+            };
+            start = now();
+            for (let i = 0; i < characteristics; i++) {
+                peripheral.notify(SERVICE, characteristic(i), onNotify);
+            }
+        });
+
+        let end;
+        const alloc = await allocation(count, async () => {
+            end = await done;
+        });
+
+        for (let i = 0; i < characteristics; i++) {
+            peripheral.unsubscribe(SERVICE, characteristic(i));
+        }
+        peripheral.disconnect();
+
+        const sorted = Array.from(latencies).sort((a, b) => a - b);
+        return {
+            count,
+            eventsPerSec: round(count / ((end - start) / 1000)),
+            latencyMs: {
+                p50: round(percentile(sorted, 0.5)),
+                p99: round(percentile(sorted, 0.99)),
+                max: round(sorted[sorted.length - 1])
+            },
+            ...alloc
+        };
+    },
+
+    // Sixteen characteristics of packed int16 x/y/z samples, decoded with a
+    // DataView per value in JS, then into native columns
+    async notifyDecoded() {
+        const characteristics = 16;
+        const samples = 3000;
+        const { peripheral } = await connected({
+            services: [{
+                uuid: SERVICE,
+                characteristics: Array.from({ length: characteristics }, (_, i) => ({
+                    uuid: characteristic(i), canNotify: true, notifyInterval: 1, notifyLength: 240
+                }))
+            }]
+        });
+        const layout = { fields: [{ name: 'x', type: 'int16' }, { name: 'y', type: 'int16' }, { name: 'z', type: 'int16' }] };
+        const rowsPerPayload = 240 / 6;
+        const count = samples * rowsPerPayload;
+
+        const measure = async subscribe => {
+            let result;
+            const alloc = await allocation(count, async () => {
+                result = await deliver(subscribe);
+            });
+            return { ...result, ...alloc };
+        };
+        const deliver = subscribe => new Promise(resolve => {
+            const x = new Int16Array(count);
+            let rows = 0;
+            const start = now();
+            subscribe((values, length) => {
+                x.set(values.subarray(0, Math.min(length, count - rows)), rows);
+                rows += length;
+                if (rows >= count) {
+                    for (let i = 0; i < characteristics; i++) {
+                        peripheral.unsubscribe(SERVICE, characteristic(i));
+                    }
+                    resolve({ rows: count, rowsPerSec: round(count / ((now() - start) / 1000)) });
+                }
+            });
+        });
+
+        const dataView = await measure(onRows => {
+            const onNotify = data => {
+                const view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+                const x = new Int16Array(rowsPerPayload);
+                for (let row = 0; row < rowsPerPayload; row++) {
+                    x[row] = view.getInt16(row * 6, true);
+                    view.getInt16(row * 6 + 2, true);
+                    view.getInt16(row * 6 + 4, true);
+                }
+                onRows(x, rowsPerPayload);
+            };
+            for (let i = 0; i < characteristics; i++) {
+                peripheral.notify(SERVICE, characteristic(i), onNotify);
+            }
+        });
+
+        const decoded = await measure(onRows => {
+            const onBatch = batch => onRows(batch.columns.x, batch.count);
+            for (let i = 0; i < characteristics; i++) {
+                peripheral.notifyDecoded(SERVICE, characteristic(i), layout, { count: 256, interval: 10, capacity: 4096 }, onBatch);
+            }
+        });
+
+        peripheral.disconnect();
+        return { rowsPerPayload, dataView, decoded };
+    },
+
+    async writeCommand() {
+        const count = 20000;
+        const asyncCount = 5000;
+        const { peripheral } = await connected({
+            services: [{ uuid: SERVICE, characteristics: [{ uuid: characteristic(0) }] }]
+        });
+        const data = new Uint8Array(20);
+
+        let start = now();
+        const alloc = await allocation(count, () => {
+            for (let i = 0; i < count; i++) {
+                peripheral.writeCommand(SERVICE, characteristic(0), data);
+            }
+        });
+        const syncElapsed = (now() - start) / 1000;
+
+        start = now();
+        for (let i = 0; i < asyncCount; i++) {
+            await peripheral.writeCommandAsync(SERVICE, characteristic(0), data);
+        }
+        const asyncElapsed = (now() - start) / 1000;
+
+        peripheral.disconnect();
+        return {
+            sync: { count, opsPerSec: round(count / syncElapsed), ...alloc },
+            async: { count: asyncCount, opsPerSec: round(asyncCount / asyncElapsed) }
+        };
+    },
+
+    // One large payload chunked to the MTU natively, then the same payload as
+    // one writeCommandAsync per chunk
+    async writeStream() {
+        const size = 256 * 1024;
+        const { peripheral } = await connected({
+            services: [{ uuid: SERVICE, characteristics: [{ uuid: characteristic(0) }] }]
+        });
+        const data = new Uint8Array(size);
+        const chunkSize = Math.max(peripheral.mtu - 3, 20);
+
+        let progressEvents = 0;
+        let start = now();
+        await peripheral.writeStream(SERVICE, characteristic(0), data, { interval: 0 }, () => progressEvents++);
+        const streamElapsed = (now() - start) / 1000;
+
+        start = now();
+        for (let offset = 0; offset < size; offset += chunkSize) {
+            await peripheral.writeCommandAsync(SERVICE, characteristic(0), data.subarray(offset, offset + chunkSize));
+        }
+        const chunkedElapsed = (now() - start) / 1000;
+
+        peripheral.disconnect();
+        return {
+            bytes: size,
+            chunkSize,
+            writeStream: { bytesPerSec: round(size / streamElapsed), progressEvents },
+            writeCommandAsync: { bytesPerSec: round(size / chunkedElapsed) }
+        };
+    },
+
+    // Polling ten characteristics with one readAsync each, then one readMany
+    async readMany() {
+        const characteristics = 10;
+        const rounds = 2000;
+        const { peripheral } = await connected({
+            services: [{
+                uuid: SERVICE,
+                characteristics: Array.from({ length: characteristics }, (_, i) => ({
+                    uuid: characteristic(i), value: new Uint8Array(8)
+                }))
+            }]
+        });
+        const entries = Array.from({ length: characteristics }, (_, i) => [SERVICE, characteristic(i)]);
+
+        let start = now();
+        for (let i = 0; i < rounds; i++) {
+            await Promise.all(entries.map(([service, char]) => peripheral.readAsync(service, char)));
+        }
+        const singleElapsed = (now() - start) / 1000;
+
+        start = now();
+        const alloc = await allocation(rounds, async () => {
+            for (let i = 0; i < rounds; i++) {
+                await peripheral.readMany(entries);
+            }
+        });
+        const manyElapsed = (now() - start) / 1000;
+
+        peripheral.disconnect();
+        return {
+            characteristics,
+            readAsync: { rounds, roundsPerSec: round(rounds / singleElapsed) },
+            readMany: { rounds, roundsPerSec: round(rounds / manyElapsed), ...alloc }
+        };
+    },
+
+    // The services accessor on a cached tree and rebuilt every time
+    async services() {
+        const services = Array.from({ length: 8 }, (_, s) => ({
+            uuid: `0000f${s}00-0000-1000-8000-00805f9b34fb`,
+            characteristics: Array.from({ length: 8 }, (_, c) => ({
+                uuid: `0000f${s}${(c + 1).toString(16).padStart(2, '0')}-0000-1000-8000-00805f9b34fb`,
+                descriptors: [{ uuid: '00002902-0000-1000-8000-00805f9b34fb' }]
+            }))
+        }));
+        const { peripheral } = await connected({ services });
+
+        const cachedCount = 100000;
+        let start = now();
+        for (let i = 0; i < cachedCount; i++) {
+            peripheral.services;
+        }
+        const cachedElapsed = (now() - start) / 1000;
+
+        const rebuiltCount = 2000;
+        start = now();
+        const alloc = await allocation(rebuiltCount, () => {
+            for (let i = 0; i < rebuiltCount; i++) {
+                peripheral.invalidateServices();
+                peripheral.services;
+            }
+        });
+        const rebuiltElapsed = (now() - start) / 1000;
+
+        peripheral.disconnect();
+        return {
+            cached: { count: cachedCount, opsPerSec: round(cachedCount / cachedElapsed) },
+            rebuilt: { count: rebuiltCount, opsPerSec: round(rebuiltCount / rebuiltElapsed), ...alloc }
+        };
+    }
+};
+
+// Current minus baseline for every number present in both, so a before and
+// after run shows e.g. the bytes allocated per notification saved
+const delta = (current, baseline) => {
+    if (typeof current === 'number' && typeof baseline === 'number') {
+        return round(current - baseline);
+    }
+    if (!current || !baseline || typeof current !== 'object' || typeof baseline !== 'object') {
+        return undefined;
+    }
+
+    const result = {};
+    for (const key of Object.keys(current)) {
+        const value = delta(current[key], baseline[key]);
+        if (value !== undefined) {
+            result[key] = value;
+        }
+    }
+    return Object.keys(result).length ? result : undefined;
+};
+
+const main = async () => {
+    if (!simpleble.simulator) {
+        throw new Error('The native module was not built with the simulator, run `yarn build:sim`');
+    }
+
+    const args = process.argv.slice(2);
+    const outputIndex = args.indexOf('--output');
+    const output = outputIndex >= 0 ? args.splice(outputIndex, 2)[1] : undefined;
+    const baselineIndex = args.indexOf('--baseline');
+    const baseline = baselineIndex >= 0 ? JSON.parse(readFileSync(args.splice(baselineIndex, 2)[1], 'utf8')) : undefined;
+    const names = args.length ? args : Object.keys(benchmarks);
+
+    const results = {};
+    for (const name of names) {
+        if (!benchmarks[name]) {
+            throw new Error(`Unknown benchmark ${name}`);
+        }
+        results[name] = await benchmarks[name]();
+    }
+
+    const report = JSON.stringify({
+        version,
+        node: process.version,
+        platform: process.platform,
+        arch: process.arch,
+        date: new Date().toISOString(),
+        gc: !!global.gc,
+        results,
+        baseline: baseline && {
+            version: baseline.version,
+            date: baseline.date,
+            delta: delta(results, baseline.results)
+        }
+    }, null, 2);
+
+    if (output) {
+        writeFileSync(output, report);
+    } else {
+        console.log(report);
+    }
+};
+
+main()
+.then(() => process.exit(0))
+.catch(error => {
+    console.error(error);
+    process.exit(1);
+});
@@ -1,7 +1,13 @@
 #include "adapter.h"
-#include "peripheral.h"
+#include "addon.h"
+#include "scan_records.h"
+#include "simpleble_c/simpleble.h"
+#include "subscription.h"
 
-Napi::FunctionReference Adapter::constructor;
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
 
 Napi::Object Adapter::Init(Napi::Env env, Napi::Object exports) {
   // clang-format off
@@ -12,18 +18,21 @@ Napi::Object Adapter::Init(Napi::Env env, Napi::Object exports) {
     InstanceAccessor<&Adapter::GetPeripherals>("peripherals"),
     InstanceAccessor<&Adapter::GetPairedPeripherals>("pairedPeripherals"),
     InstanceMethod("scanFor", &Adapter::ScanFor),
+    InstanceMethod("scanForAsync", &Adapter::ScanForAsync),
+    InstanceMethod("scanResults", &Adapter::ScanResults),
     InstanceMethod("scanStart", &Adapter::ScanStart),
     InstanceMethod("scanStop", &Adapter::ScanStop),
     InstanceMethod("setCallbackOnScanStart", &Adapter::SetCallbackOnScanStart),
     InstanceMethod("setCallbackOnScanStop", &Adapter::SetCallbackOnScanStop),
     InstanceMethod("setCallbackOnScanUpdated", &Adapter::SetCallbackOnScanUpdated),
     InstanceMethod("setCallbackOnScanFound", &Adapter::SetCallbackOnScanFound),
+    InstanceMethod("setScanFilter", &Adapter::SetScanFilter),
+    InstanceMethod("scanStats", &Adapter::ScanStats),
     InstanceMethod("release", &Adapter::Release)
   });
   // clang-format on
 
-  constructor = Napi::Persistent(func);
-  constructor.SuppressDestruct();
+  AddonData::Get(env)->adapterConstructor = Napi::Persistent(func);
 
   exports.Set("Adapter", func);
   return exports;
@@ -38,28 +47,54 @@ Adapter::Adapter(const Napi::CallbackInfo &info)
         .ThrowAsJavaScriptException();
     return;
   }
+  AddonData::Get(env)->live.insert(this);
+
   size_t index = info[0].As<Napi::Number>().Int64Value();
   this->handle = simpleble_adapter_get_handle(index);
+
+  char *address = this->handle != nullptr
+                      ? simpleble_adapter_address(this->handle)
+                      : nullptr;
+  this->metrics =
+      Metrics::New(env, "adapter", address != nullptr ? address : "");
+  free(address);
 }
 
 Adapter::~Adapter() {
+  if (auto data = AddonData::Get(Env())) {
+    data->live.erase(this);
+  }
+  Free();
+}
+
+void Adapter::Free() {
+  CancelScanFor();
+  if (this->scanForThread.joinable()) {
+    this->scanForThread.join();
+  }
+
   if (this->handle != nullptr) {
+    simpleble_adapter_scan_stop(this->handle);
     simpleble_adapter_release_handle(this->handle);
   }
   if (this->onScanStartFn) {
     this->onScanStartFn.Release();
+    this->onScanStartFn = Napi::ThreadSafeFunction();
   }
 
   if (this->onScanStopFn) {
     this->onScanStopFn.Release();
+    this->onScanStopFn = Napi::ThreadSafeFunction();
   }
 
-  if (this->onScanUpdatedFn) {
-    this->onScanUpdatedFn.Release();
+  if (this->onScanUpdatedEvents != nullptr) {
+    this->onScanUpdatedEvents->Close();
+    this->onScanUpdatedEvents = nullptr;
   }
 
-  if (this->onScanFoundFn) {
-    this->onScanFoundFn.Release();
+  if (this->onScanFoundEvents != nullptr) {
+    this->onScanFoundEvents->Close();
+    this->onScanFoundEvents = nullptr;
   }
 
   this->handle = nullptr;
@@ -98,6 +133,10 @@ Napi::Value Adapter::IsActive(const Napi::CallbackInfo &info) {
 Napi::Value Adapter::ScanStart(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
+  this->filter->Reset();
+  if (this->onScanUpdatedEvents != nullptr) {
+    this->onScanUpdatedEvents->Reset();
+  }
   auto err = simpleble_adapter_scan_start(this->handle);
 
   return Napi::Boolean::New(env, err == SIMPLEBLE_SUCCESS);
@@ -106,6 +145,7 @@ Napi::Value Adapter::ScanStart(const Napi::CallbackInfo &info) {
 Napi::Value Adapter::ScanStop(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
+  CancelScanFor();
   auto err = simpleble_adapter_scan_stop(this->handle);
 
   return Napi::Boolean::New(env, err == SIMPLEBLE_SUCCESS);
@@ -124,11 +164,102 @@ Napi::Value Adapter::ScanFor(const Napi::CallbackInfo &info) {
   }
 
   auto timeout = info[0].As<Napi::Number>().Int64Value();
+  this->filter->Reset();
+  if (this->onScanUpdatedEvents != nullptr) {
+    this->onScanUpdatedEvents->Reset();
+  }
   auto err = simpleble_adapter_scan_for(this->handle, timeout);
 
   return Napi::Boolean::New(env, err == SIMPLEBLE_SUCCESS);
 }
 
+Napi::Value Adapter::ScanForAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1) {
+    Napi::TypeError::New(env, "Missing timeout").ThrowAsJavaScriptException();
+    return env.Null();
+  } else if (!info[0].IsNumber()) {
+    Napi::TypeError::New(env, "Timeout is not a number")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  const auto timeout = info[0].As<Napi::Number>().Int64Value();
+  auto deferred = Napi::Promise::Deferred::New(env);
+
+  if (this->scanForPending) {
+    deferred.Reject(
+        Napi::Error::New(env, "Scan already in progress").Value());
+    return deferred.Promise();
+  }
+  if (this->scanForThread.joinable()) {
+    this->scanForThread.join();
+  }
+
+  this->filter->Reset();
+  if (this->onScanUpdatedEvents != nullptr) {
+    this->onScanUpdatedEvents->Reset();
+  }
+  if (simpleble_adapter_scan_start(this->handle) != SIMPLEBLE_SUCCESS) {
+    deferred.Reject(Napi::Error::New(env, "Scan failed").Value());
+    return deferred.Promise();
+  }
+
+  this->scanForPending = true;
+  this->scanForCancelled = false;
+  Ref();
+
+  auto settleFn = ScanForFn::New(env, "scanFor", 0, 1, this);
+  auto pending = new Napi::Promise::Deferred(deferred);
+  this->scanForThread = std::thread([this, timeout, settleFn,
+                                     pending]() mutable {
+    {
+      std::unique_lock<std::mutex> lock(this->scanForMutex);
+      this->scanForWake.wait_for(
+          lock, std::chrono::milliseconds(std::max<int64_t>(timeout, 0)),
+          [this] { return this->scanForCancelled; });
+    }
+
+    simpleble_adapter_scan_stop(this->handle);
+    if (settleFn.BlockingCall(pending) != napi_ok) {
+      delete pending;
+    }
+    settleFn.Release();
+  });
+
+  return deferred.Promise();
+}
+
+void Adapter::SettleScanFor(Napi::Env env, Napi::Function, Adapter *adapter,
+                            Napi::Promise::Deferred *deferred) {
+  if (env != nullptr) {
+    adapter->scanForPending = false;
+    deferred->Resolve(env.Undefined());
+    adapter->Unref();
+  }
+  delete deferred;
+}
+
+void Adapter::Shutdown() {
+  CancelScanFor();
+  if (this->scanForThread.joinable()) {
+    this->scanForThread.join();
+  }
+
+  if (this->handle != nullptr) {
+    simpleble_adapter_scan_stop(this->handle);
+  }
+}
+
+void Adapter::CancelScanFor() {
+  {
+    std::lock_guard<std::mutex> lock(this->scanForMutex);
+    this->scanForCancelled = true;
+  }
+  this->scanForWake.notify_one();
+}
+
 Napi::Value Adapter::GetPeripherals(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
@@ -138,14 +269,16 @@ Napi::Value Adapter::GetPeripherals(const Napi::CallbackInfo &info) {
   for (size_t i = 0; i < count; i++) {
     simpleble_peripheral_t peripheral =
         simpleble_adapter_scan_get_results_handle(this->handle, i);
-    Napi::Value peripheralInstance = Peripheral::constructor.New(
-        {Napi::BigInt::New(env, reinterpret_cast<uint64_t>(peripheral))});
-    peripherals.Set(i, peripheralInstance);
+    peripherals.Set(i, this->peripherals->Get(env, peripheral));
   }
 
   return peripherals;
 }
 
+Napi::Value Adapter::ScanResults(const Napi::CallbackInfo &info) {
+  return PackScanResults(info.Env(), this->handle);
+}
+
 Napi::Value Adapter::GetPairedPeripherals(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
@@ -155,9 +288,7 @@ Napi::Value Adapter::GetPairedPeripherals(const Napi::CallbackInfo &info) {
   for (size_t i = 0; i < count; i++) {
     simpleble_peripheral_t peripheral =
         simpleble_adapter_get_paired_peripherals_handle(this->handle, i);
-    Napi::Value peripheralInstance = Peripheral::constructor.New(
-        {Napi::BigInt::New(env, reinterpret_cast<uint64_t>(peripheral))});
-    peripherals.Set(i, peripheralInstance);
+    peripherals.Set(i, this->peripherals->Get(env, peripheral));
   }
 
   return peripherals;
@@ -218,7 +349,19 @@ Napi::Value Adapter::SetCallbackOnScanStop(const Napi::CallbackInfo &info) {
 }
 
 Napi::Value Adapter::SetCallbackOnScanUpdated(const Napi::CallbackInfo &info) {
+  return SetScanCallback(info, this->onScanUpdatedEvents, "onScanUpdatedFn",
+                         false);
+}
+
+Napi::Value Adapter::SetCallbackOnScanFound(const Napi::CallbackInfo &info) {
+  return SetScanCallback(info, this->onScanFoundEvents, "onScanFoundFn", true);
+}
+
+Napi::Value Adapter::SetScanCallback(const Napi::CallbackInfo &info,
+                                     ScanEvents *&events, const char *name,
+                                     bool found) {
   Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
 
   if (info.Length() < 1) {
     Napi::TypeError::New(env, "No callback given").ThrowAsJavaScriptException();
@@ -229,51 +372,94 @@ Napi::Value Adapter::SetCallbackOnScanUpdated(const Napi::CallbackInfo &info) {
     return Napi::Boolean::New(env, false);
   }
 
-  this->onScanUpdatedFn = Napi::ThreadSafeFunction::New(
-      env, info[0].As<Napi::Function>(), "onScanUpdatedFn", 0, 1);
-  this->onScanUpdatedFn.Unref(env);
+  Subscription::Options options;
+  ScanEvents::Coalesce coalesce;
+  if (info.Length() > 1 && info[1].IsObject()) {
+    auto obj = info[1].As<Napi::Object>();
+    if (!Subscription::ParseOptions(env, obj, options)) {
+      return Napi::Boolean::New(env, false);
+    }
+    // Found events fire once per peripheral, there is nothing to coalesce
+    if (!found && !ScanEvents::ParseCoalesce(env, obj, coalesce)) {
+      return Napi::Boolean::New(env, false);
+    }
+  }
 
-  const auto ret = simpleble_adapter_set_callback_on_scan_updated(
-      this->handle, onScanUpdated, this);
+  auto previous = events;
+  events = ScanEvents::New(env, info[0].As<Napi::Function>(), name,
+                           options.capacity, options.overflow,
+                           options.blockTimeout, this->filter, this->metrics,
+                           this->peripherals, found, coalesce);
 
-  if (ret != SIMPLEBLE_SUCCESS) {
-    return Napi::Boolean::New(env, false);
+  const auto ret =
+      found ? simpleble_adapter_set_callback_on_scan_found(
+                  this->handle, onScanFound, events)
+            : simpleble_adapter_set_callback_on_scan_updated(
+                  this->handle, onScanUpdated, events);
+
+  if (previous != nullptr) {
+    previous->Close();
   }
 
-  return Napi::Boolean::New(env, true);
+  return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
 }
 
-Napi::Value Adapter::SetCallbackOnScanFound(const Napi::CallbackInfo &info) {
+Napi::Value Adapter::SetScanFilter(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
-  Napi::HandleScope scope(env);
 
-  if (info.Length() < 1) {
-    Napi::TypeError::New(env, "No callback given").ThrowAsJavaScriptException();
-    return Napi::Boolean::New(env, false);
-  } else if (!info[0].IsFunction()) {
-    Napi::TypeError::New(env, "Callback is not a function")
-        .ThrowAsJavaScriptException();
-    return Napi::Boolean::New(env, false);
+  // A missing or null filter clears it
+  ScanFilter::Criteria criteria;
+  if (info.Length() > 0 && !info[0].IsUndefined() && !info[0].IsNull()) {
+    if (!info[0].IsObject()) {
+      Napi::TypeError::New(env, "Filter is not an object")
+          .ThrowAsJavaScriptException();
+      return Napi::Boolean::New(env, false);
+    }
+    if (!ScanFilter::Parse(env, info[0].As<Napi::Object>(), criteria)) {
+      return Napi::Boolean::New(env, false);
+    }
   }
 
-  this->onScanFoundFn = Napi::ThreadSafeFunction::New(
-      env, info[0].As<Napi::Function>(), "onScanFoundFn", 0, 1);
-  this->onScanFoundFn.Unref(env);
-
-  const auto ret = simpleble_adapter_set_callback_on_scan_found(
-      this->handle, onScanFound, this);
+  this->filter->Set(criteria);
+  return Napi::Boolean::New(env, true);
+}
 
-  if (ret != SIMPLEBLE_SUCCESS) {
-    return Napi::Boolean::New(env, false);
-  }
+Napi::Value Adapter::ScanStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
 
-  return Napi::Boolean::New(env, true);
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("foundDropped", double(this->onScanFoundEvents != nullptr
+                                     ? this->onScanFoundEvents->Dropped()
+                                     : 0));
+  obj.Set("updatedDropped", double(this->onScanUpdatedEvents != nullptr
+                                       ? this->onScanUpdatedEvents->Dropped()
+                                       : 0));
+  obj.Set("foundFiltered", double(this->onScanFoundEvents != nullptr
+                                      ? this->onScanFoundEvents->Filtered()
+                                      : 0));
+  obj.Set("updatedFiltered", double(this->onScanUpdatedEvents != nullptr
+                                        ? this->onScanUpdatedEvents->Filtered()
+                                        : 0));
+  obj.Set("updatedSuppressed",
+          double(this->onScanUpdatedEvents != nullptr
+                     ? this->onScanUpdatedEvents->Suppressed()
+                     : 0));
+  return obj;
 }
 
 Napi::Value Adapter::Release(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
-  delete this;
+  // The wrapper stays with JS until collected, getAdapters hands out a new one
+  auto data = AddonData::Get(env);
+  for (auto &adapter : data->adapters) {
+    if (!adapter.IsEmpty() && adapter.Value().StrictEquals(Value())) {
+      adapter.Reset();
+    }
+  }
+  data->live.erase(this);
+
+  Free();
 
   return env.Null();
 }
@@ -296,24 +482,218 @@ void Adapter::onScanStop(simpleble_adapter_t handle, void *userdata) {
 
 void Adapter::onScanUpdated(simpleble_adapter_t handle,
                             simpleble_peripheral_t peripheral, void *userdata) {
-  auto adapter = reinterpret_cast<Adapter *>(userdata);
-  auto callback = [](Napi::Env env, Napi::Function jsCallback,
-                     simpleble_peripheral_t peripheral) {
-    Napi::Value peripheralInstance = Peripheral::constructor.New(
-        {Napi::BigInt::New(env, reinterpret_cast<uint64_t>(peripheral))});
-    jsCallback.Call({peripheralInstance});
-  };
-  adapter->onScanUpdatedFn.NonBlockingCall(peripheral, callback);
+  reinterpret_cast<ScanEvents *>(userdata)->Push(peripheral);
 }
 
 void Adapter::onScanFound(simpleble_adapter_t handle,
                           simpleble_peripheral_t peripheral, void *userdata) {
-  auto adapter = reinterpret_cast<Adapter *>(userdata);
-  auto callback = [](Napi::Env env, Napi::Function jsCallback,
-                     simpleble_peripheral_t peripheral) {
-    Napi::Value peripheralInstance = Peripheral::constructor.New(
-        {Napi::BigInt::New(env, reinterpret_cast<uint64_t>(peripheral))});
-    jsCallback.Call({peripheralInstance});
-  };
-  adapter->onScanFoundFn.NonBlockingCall(peripheral, callback);
+  reinterpret_cast<ScanEvents *>(userdata)->Push(peripheral);
+}
+
+Adapter::ScanEvents *Adapter::ScanEvents::New(
+    Napi::Env env, Napi::Function callback, const char *name, size_t capacity,
+    Overflow overflow, uint32_t blockTimeout,
+    std::shared_ptr<ScanFilter> filter, std::shared_ptr<Metrics> metrics,
+    std::shared_ptr<PeripheralMap> peripherals, bool found,
+    const Coalesce &coalesce) {
+  auto events = new ScanEvents(capacity, overflow, blockTimeout,
+                               std::move(filter), std::move(metrics),
+                               std::move(peripherals), found, coalesce);
+
+  events->drainFn = DrainFn::New(
+      env, callback, name, 0, 1, events,
+      [](Napi::Env, ScanEvents *events, ScanEvents *) { delete events; },
+      events);
+  events->drainFn.Unref(env);
+
+  if (coalesce.window > 0) {
+    events->flusher = std::thread(&ScanEvents::Flush, events);
+  }
+
+  return events;
+}
+
+bool Adapter::ScanEvents::ParseCoalesce(Napi::Env env, Napi::Object obj,
+                                        Coalesce &coalesce) {
+  if (obj.Get("window").IsNumber()) {
+    const auto window = obj.Get("window").As<Napi::Number>().Int64Value();
+    if (window < 0) {
+      Napi::RangeError::New(env, "Window must not be negative")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    coalesce.window = window;
+  }
+
+  if (obj.Get("rssiDelta").IsNumber()) {
+    const auto rssiDelta =
+        obj.Get("rssiDelta").As<Napi::Number>().Int64Value();
+    if (rssiDelta < 0) {
+      Napi::RangeError::New(env, "RSSI delta must not be negative")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    coalesce.rssiDelta = rssiDelta;
+  }
+
+  return true;
+}
+
+void Adapter::ScanEvents::Push(simpleble_peripheral_t peripheral) {
+  this->metrics->Received(1);
+
+  if (!this->filter->Accept(peripheral, this->found)) {
+    this->filtered.fetch_add(1, std::memory_order_relaxed);
+    simpleble_peripheral_release_handle(peripheral);
+    return;
+  }
+
+  if ((this->coalesce.window > 0 || this->coalesce.rssiDelta > 0) &&
+      !Coalesced(peripheral)) {
+    return;
+  }
+
+  Enqueue(peripheral);
+}
+
+void Adapter::ScanEvents::Enqueue(simpleble_peripheral_t peripheral) {
+  this->ring.Push(peripheral);
+
+  if (this->scheduled.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  this->scheduledAt.store(Metrics::Now(), std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->closed) {
+    this->drainFn.NonBlockingCall();
+  }
+}
+
+bool Adapter::ScanEvents::Coalesced(simpleble_peripheral_t peripheral) {
+  char *value = simpleble_peripheral_address(peripheral);
+  const std::string address(value != nullptr ? value : "");
+  simpleble_free(value);
+  const int16_t rssi = simpleble_peripheral_rssi(peripheral);
+
+  simpleble_peripheral_t replaced = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(this->devicesMutex);
+    Device &device = this->devices[address];
+
+    if (this->coalesce.rssiDelta > 0 && device.reported &&
+        uint32_t(std::abs(rssi - device.rssi)) < this->coalesce.rssiDelta) {
+      replaced = peripheral;
+    } else if (this->coalesce.window == 0) {
+      device.reported = true;
+      device.rssi = rssi;
+      return true;
+    } else {
+      // Latest wins, the flusher delivers it when the window closes
+      replaced = device.pending;
+      device.pending = peripheral;
+    }
+  }
+
+  if (replaced != nullptr) {
+    this->suppressed.fetch_add(1, std::memory_order_relaxed);
+    simpleble_peripheral_release_handle(replaced);
+  }
+  return false;
+}
+
+void Adapter::ScanEvents::Flush() {
+  std::vector<simpleble_peripheral_t> pending;
+  std::unique_lock<std::mutex> lock(this->devicesMutex);
+
+  while (!this->stopping) {
+    this->wake.wait_for(lock, std::chrono::milliseconds(this->coalesce.window));
+    if (this->stopping) {
+      break;
+    }
+
+    for (auto &entry : this->devices) {
+      Device &device = entry.second;
+      if (device.pending != nullptr) {
+        device.reported = true;
+        device.rssi = simpleble_peripheral_rssi(device.pending);
+        pending.push_back(device.pending);
+        device.pending = nullptr;
+      }
+    }
+
+    // Enqueued outside the lock so producers aren't held up by a full ring
+    lock.unlock();
+    for (auto peripheral : pending) {
+      Enqueue(peripheral);
+    }
+    pending.clear();
+    lock.lock();
+  }
+}
+
+void Adapter::ScanEvents::Reset() {
+  std::lock_guard<std::mutex> lock(this->devicesMutex);
+  for (auto &entry : this->devices) {
+    if (entry.second.pending != nullptr) {
+      simpleble_peripheral_release_handle(entry.second.pending);
+    }
+  }
+  this->devices.clear();
+}
+
+void Adapter::ScanEvents::Close() {
+  // First, a producer blocked on a full ring is waiting for JS
+  this->ring.Close();
+  {
+    std::lock_guard<std::mutex> lock(this->devicesMutex);
+    this->stopping = true;
+  }
+  this->wake.notify_all();
+  if (this->flusher.joinable()) {
+    this->flusher.join();
+  }
+  Reset();
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->closed = true;
+  }
+  this->drainFn.Release();
+}
+
+void Adapter::ScanEvents::Drain(Napi::Env env, Napi::Function jsCallback,
+                                ScanEvents *events, std::nullptr_t *) {
+  events->scheduled.store(false, std::memory_order_release);
+
+  {
+    std::lock_guard<std::mutex> lock(events->mutex);
+    if (env == nullptr || events->closed) {
+      return;
+    }
+  }
+
+  events->metrics->Dispatched(
+      events->scheduledAt.load(std::memory_order_relaxed));
+  events->metrics->Queued(events->ring.Size());
+
+  std::vector<Napi::Value> peripherals;
+  for (size_t i = events->ring.Capacity(); i > 0; i--) {
+    auto peripheral = events->ring.Pop();
+    if (peripheral == nullptr) {
+      break;
+    }
+    peripherals.push_back(events->peripherals->Get(env, peripheral));
+  }
+
+  if (events->ring.Size() > 0 &&
+      !events->scheduled.exchange(true, std::memory_order_acq_rel)) {
+    events->scheduledAt.store(Metrics::Now(), std::memory_order_relaxed);
+    events->drainFn.NonBlockingCall();
+  }
+
+  events->metrics->Delivered(peripherals.size());
+  for (auto &peripheral : peripherals) {
+    jsCallback.Call({peripheral});
+  }
 }
@@ -1,7 +1,19 @@
 #pragma once
 
+#include "metrics.h"
+#include "peripheral_map.h"
+#include "ring_buffer.h"
+#include "scan_filter.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <napi.h>
 #include <simpleble_c/adapter.h>
+#include <simpleble_c/peripheral.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 class Adapter : public Napi::ObjectWrap<Adapter> {
 public:
@@ -9,14 +21,134 @@ public:
   Adapter(const Napi::CallbackInfo &info);
   ~Adapter();
 
-  static Napi::FunctionReference constructor;
+  // Stops scanning without touching JS, called as the environment shuts down.
+  void Shutdown();
 
 private:
+  // Peripherals reported by a scan callback, handed to JS through a bounded
+  // ring with at most one wakeup queued at a time. Peripherals rejected by the
+  // adapter's filter are released before reaching the ring. Freed by its
+  // thread-safe function once closed.
+  //
+  // Updates can be coalesced per peripheral: with a window only the latest
+  // update for each address is delivered every `window` milliseconds, and with
+  // an RSSI delta updates within `rssiDelta` dBm of the last delivered value
+  // are dropped.
+  class ScanEvents {
+  public:
+    struct Coalesce {
+      uint32_t window = 0;
+      uint32_t rssiDelta = 0;
+    };
+
+    static ScanEvents *New(Napi::Env env, Napi::Function callback,
+                           const char *name, size_t capacity,
+                           Overflow overflow, uint32_t blockTimeout,
+                           std::shared_ptr<ScanFilter> filter,
+                           std::shared_ptr<Metrics> metrics,
+                           std::shared_ptr<PeripheralMap> peripherals,
+                           bool found, const Coalesce &coalesce);
+
+    // Reads window and rssiDelta from a JS options object, throwing on
+    // invalid values.
+    static bool ParseCoalesce(Napi::Env env, Napi::Object obj,
+                              Coalesce &coalesce);
+
+    void Push(simpleble_peripheral_t peripheral);
+    // Forgets coalescing state, called when a scan starts.
+    void Reset();
+    void Close();
+    uint64_t Dropped() const { return this->ring.Dropped(); }
+    uint64_t Filtered() const {
+      return this->filtered.load(std::memory_order_relaxed);
+    }
+    uint64_t Suppressed() const {
+      return this->suppressed.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static void Drain(Napi::Env env, Napi::Function jsCallback,
+                      ScanEvents *events, std::nullptr_t *);
+    using DrainFn =
+        Napi::TypedThreadSafeFunction<ScanEvents, std::nullptr_t, Drain>;
+
+    ScanEvents(size_t capacity, Overflow overflow, uint32_t blockTimeout,
+               std::shared_ptr<ScanFilter> filter,
+               std::shared_ptr<Metrics> metrics,
+               std::shared_ptr<PeripheralMap> peripherals, bool found,
+               const Coalesce &coalesce)
+        : ring(capacity, overflow, simpleble_peripheral_release_handle,
+               std::chrono::milliseconds(blockTimeout)),
+          filter(std::move(filter)), metrics(std::move(metrics)),
+          peripherals(std::move(peripherals)), found(found),
+          coalesce(coalesce) {}
+
+    // Last delivered RSSI and the update waiting for the next window
+    struct Device {
+      bool reported = false;
+      int16_t rssi = 0;
+      simpleble_peripheral_t pending = nullptr;
+    };
+
+    void Enqueue(simpleble_peripheral_t peripheral);
+    // Returns true if the update should be delivered straight away.
+    bool Coalesced(simpleble_peripheral_t peripheral);
+    void Flush();
+
+    DrainFn drainFn;
+    RingBuffer<void> ring;
+    std::shared_ptr<ScanFilter> filter;
+    std::shared_ptr<Metrics> metrics;
+    std::shared_ptr<PeripheralMap> peripherals;
+    const bool found;
+    std::atomic<uint64_t> filtered{0};
+
+    const Coalesce coalesce;
+    std::atomic<uint64_t> suppressed{0};
+    std::mutex devicesMutex;
+    std::unordered_map<std::string, Device> devices;
+    bool stopping = false;
+    std::thread flusher;
+    std::condition_variable wake;
+    std::atomic<bool> scheduled{false};
+    std::atomic<uint64_t> scheduledAt{0};
+    std::mutex mutex;
+    bool closed = false;
+  };
+
   simpleble_adapter_t handle;
+  // Stops scanning and releases the handle and every callback, safe to call
+  // again once released.
+  void Free();
+
+  // A scanForAsync waits out its timeout on its own thread, scanStop ends it
+  // early. The wrapper is referenced until the promise settles.
+  static void SettleScanFor(Napi::Env env, Napi::Function, Adapter *adapter,
+                            Napi::Promise::Deferred *deferred);
+  using ScanForFn = Napi::TypedThreadSafeFunction<Adapter,
+                                                  Napi::Promise::Deferred,
+                                                  SettleScanFor>;
+  std::thread scanForThread;
+  std::mutex scanForMutex;
+  std::condition_variable scanForWake;
+  bool scanForPending = false;
+  bool scanForCancelled = false;
+  void CancelScanFor();
+
   Napi::ThreadSafeFunction onScanStartFn;
   Napi::ThreadSafeFunction onScanStopFn;
-  Napi::ThreadSafeFunction onScanUpdatedFn;
-  Napi::ThreadSafeFunction onScanFoundFn;
+  ScanEvents *onScanUpdatedEvents = nullptr;
+  ScanEvents *onScanFoundEvents = nullptr;
+  // Shared with the scan events, which may outlive the adapter briefly
+  std::shared_ptr<ScanFilter> filter = std::make_shared<ScanFilter>();
+  std::shared_ptr<Metrics> metrics;
+  // Shared with the scan events, wrappers are only touched on the JS thread
+  std::shared_ptr<PeripheralMap> peripherals =
+      std::make_shared<PeripheralMap>();
+
+  Napi::Value SetScanCallback(const Napi::CallbackInfo &info,
+                              ScanEvents *&events, const char *name,
+                              bool found);
 
   static void onScanStart(simpleble_adapter_t handle, void *userdata);
   static void onScanStop(simpleble_adapter_t handle, void *userdata);
@@ -29,11 +161,15 @@ private:
   Napi::Value ScanStart(const Napi::CallbackInfo &info);
   Napi::Value ScanStop(const Napi::CallbackInfo &info);
   Napi::Value ScanFor(const Napi::CallbackInfo &info);
+  Napi::Value ScanForAsync(const Napi::CallbackInfo &info);
   Napi::Value GetPeripherals(const Napi::CallbackInfo &info);
+  Napi::Value ScanResults(const Napi::CallbackInfo &info);
   Napi::Value GetPairedPeripherals(const Napi::CallbackInfo &info);
   Napi::Value SetCallbackOnScanStart(const Napi::CallbackInfo &info);
   Napi::Value SetCallbackOnScanStop(const Napi::CallbackInfo &info);
   Napi::Value SetCallbackOnScanUpdated(const Napi::CallbackInfo &info);
   Napi::Value SetCallbackOnScanFound(const Napi::CallbackInfo &info);
+  Napi::Value SetScanFilter(const Napi::CallbackInfo &info);
+  Napi::Value ScanStats(const Napi::CallbackInfo &info);
   Napi::Value Release(const Napi::CallbackInfo &info);
 };
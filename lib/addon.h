@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <napi.h>
+#include <unordered_set>
+#include <vector>
+
+class Adapter;
+class Metrics;
+class Peripheral;
+
+// State owned by one environment, the main thread or a worker, so the addon
+// can be loaded by several at once. Set up by Init and freed along with the
+// environment.
+struct AddonData {
+  Napi::FunctionReference adapterConstructor;
+  Napi::FunctionReference peripheralConstructor;
+  Napi::FunctionReference attributeConstructor;
+
+  // Wrappers handed out by getAdapters, created once per environment
+  std::vector<Napi::ObjectReference> adapters;
+
+  // Adapters alive in this environment, their scans are stopped when it shuts
+  // down so SimpleBLE stops calling into it
+  std::unordered_set<Adapter *> live;
+
+  // Peripherals with live subscriptions, unsubscribed when it shuts down
+  std::unordered_set<Peripheral *> subscribed;
+
+  // Weak, so getMetrics() lists an instance only while its adapter,
+  // peripheral or subscriptions are alive. Only touched on the JS thread.
+  std::vector<std::weak_ptr<Metrics>> metrics;
+
+  static AddonData *Get(Napi::Env env) {
+    return env.GetInstanceData<AddonData>();
+  }
+};
@@ -0,0 +1,333 @@
+#include "attribute.h"
+#include "addon.h"
+#include "buffer.h"
+#include "simpleble_c/simpleble.h"
+
+#include <vector>
+
+Napi::Object Attribute::Init(Napi::Env env, Napi::Object exports) {
+  // clang-format off
+  Napi::Function func = DefineClass(env, "Attribute", {
+    InstanceAccessor<&Attribute::Service>("service"),
+    InstanceAccessor<&Attribute::Characteristic>("characteristic"),
+    InstanceAccessor<&Attribute::Descriptor>("descriptor"),
+    InstanceMethod("read", &Attribute::Read),
+    InstanceMethod("readAsync", &Attribute::ReadAsync),
+    InstanceMethod("writeRequest", &Attribute::WriteRequest),
+    InstanceMethod("writeRequestAsync", &Attribute::WriteRequestAsync),
+    InstanceMethod("writeCommand", &Attribute::WriteCommand),
+    InstanceMethod("writeCommandAsync", &Attribute::WriteCommandAsync),
+    InstanceMethod("notify", &Attribute::Notify),
+    InstanceMethod("notifyBatched", &Attribute::NotifyBatched),
+    InstanceMethod("indicate", &Attribute::Indicate),
+    InstanceMethod("unsubscribe", &Attribute::Unsubscribe),
+  });
+  // clang-format on
+
+  AddonData::Get(env)->attributeConstructor = Napi::Persistent(func);
+
+  exports.Set("Attribute", func);
+  return exports;
+}
+
+Attribute::Attribute(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<Attribute>(info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 3 || !info[0].IsObject() ||
+      !info[0].As<Napi::Object>().InstanceOf(
+          AddonData::Get(env)->peripheralConstructor.Value())) {
+    Napi::TypeError::New(env, "Attribute should not be created directly")
+        .ThrowAsJavaScriptException();
+    return;
+  }
+
+  if (!GetUuidArg(info, 1, "service", this->service) ||
+      !GetUuidArg(info, 2, "characteristic", this->characteristic)) {
+    return;
+  }
+
+  memset(this->descriptor.value, 0, SIMPLEBLE_UUID_STR_LEN);
+  if (info.Length() > 3) {
+    if (!GetUuidArg(info, 3, "descriptor", this->descriptor)) {
+      return;
+    }
+    this->isDescriptor = true;
+  }
+
+  Napi::Object obj = info[0].As<Napi::Object>();
+  this->peripheral = Peripheral::Unwrap(obj);
+  this->owner = Napi::Persistent(obj);
+}
+
+Napi::Value Attribute::Service(const Napi::CallbackInfo &info) {
+  return Napi::String::New(info.Env(), this->service.value);
+}
+
+Napi::Value Attribute::Characteristic(const Napi::CallbackInfo &info) {
+  return Napi::String::New(info.Env(), this->characteristic.value);
+}
+
+Napi::Value Attribute::Descriptor(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!this->isDescriptor) {
+    return env.Undefined();
+  }
+  return Napi::String::New(env, this->descriptor.value);
+}
+
+Napi::Value Attribute::Read(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  uint8_t *data_ptr = nullptr;
+  size_t data_length = 0;
+
+  const auto ret = this->peripheral->GetMetrics()->Time([&] {
+    return this->isDescriptor
+               ? simpleble_peripheral_read_descriptor(
+                     this->peripheral->handle, this->service,
+                     this->characteristic, this->descriptor, &data_ptr,
+                     &data_length)
+               : simpleble_peripheral_read(this->peripheral->handle,
+                                           this->service, this->characteristic,
+                                           &data_ptr, &data_length);
+  });
+  if (ret != SIMPLEBLE_SUCCESS) {
+    simpleble_free(data_ptr);
+    return env.Undefined();
+  }
+
+  return AdoptBuffer(env, data_ptr, data_length);
+}
+
+Napi::Value Attribute::ReadAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  auto handle = this->peripheral->handle;
+  auto service = this->service;
+  auto characteristic = this->characteristic;
+  auto descriptor = this->descriptor;
+  auto isDescriptor = this->isDescriptor;
+
+  return this->peripheral->Queue().Push(
+      env, this->owner.Value(),
+      [handle, service, characteristic, descriptor,
+       isDescriptor](std::vector<uint8_t> &data) {
+        uint8_t *data_ptr = nullptr;
+        size_t data_length = 0;
+
+        auto ret = isDescriptor ? simpleble_peripheral_read_descriptor(
+                                      handle, service, characteristic,
+                                      descriptor, &data_ptr, &data_length)
+                                : simpleble_peripheral_read(
+                                      handle, service, characteristic,
+                                      &data_ptr, &data_length);
+        if (ret == SIMPLEBLE_SUCCESS) {
+          data.assign(data_ptr, data_ptr + data_length);
+        }
+        simpleble_free(data_ptr);
+        return ret;
+      },
+      "Read failed", true);
+}
+
+Napi::Value Attribute::WriteRequest(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1) {
+    Napi::TypeError::New(env, "Missing data").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[0].IsTypedArray()) {
+    Napi::TypeError::New(env, "Invalid data").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // Written straight from the JS buffer, the call is synchronous
+  const auto array = info[0].As<Napi::Uint8Array>();
+  const auto ret = this->peripheral->GetMetrics()->Time([&] {
+    return this->isDescriptor
+               ? simpleble_peripheral_write_descriptor(
+                     this->peripheral->handle, this->service,
+                     this->characteristic, this->descriptor, array.Data(),
+                     array.ByteLength())
+               : simpleble_peripheral_write_request(
+                     this->peripheral->handle, this->service,
+                     this->characteristic, array.Data(), array.ByteLength());
+  });
+  return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
+}
+
+Napi::Value Attribute::WriteRequestAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::vector<uint8_t> payload;
+  if (!GetDataArg(info, 0, payload)) {
+    return env.Undefined();
+  }
+
+  auto handle = this->peripheral->handle;
+  auto service = this->service;
+  auto characteristic = this->characteristic;
+  auto descriptor = this->descriptor;
+  auto isDescriptor = this->isDescriptor;
+
+  return this->peripheral->Queue().Push(
+      env, this->owner.Value(),
+      [handle, service, characteristic, descriptor, isDescriptor,
+       payload](std::vector<uint8_t> &) {
+        return isDescriptor
+                   ? simpleble_peripheral_write_descriptor(
+                         handle, service, characteristic, descriptor,
+                         payload.data(), payload.size())
+                   : simpleble_peripheral_write_request(
+                         handle, service, characteristic, payload.data(),
+                         payload.size());
+      },
+      "Write failed", false);
+}
+
+Napi::Value Attribute::WriteCommand(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!RequireCharacteristic(env)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1) {
+    Napi::TypeError::New(env, "Missing data").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[0].IsTypedArray()) {
+    Napi::TypeError::New(env, "Invalid data").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  const auto array = info[0].As<Napi::Uint8Array>();
+  const auto ret = this->peripheral->GetMetrics()->Time([&] {
+    return simpleble_peripheral_write_command(
+        this->peripheral->handle, this->service, this->characteristic,
+        array.Data(), array.ByteLength());
+  });
+  return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
+}
+
+Napi::Value Attribute::WriteCommandAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::vector<uint8_t> payload;
+  if (!RequireCharacteristic(env) || !GetDataArg(info, 0, payload)) {
+    return env.Undefined();
+  }
+
+  auto handle = this->peripheral->handle;
+  auto service = this->service;
+  auto characteristic = this->characteristic;
+
+  return this->peripheral->Queue().Push(
+      env, this->owner.Value(),
+      [handle, service, characteristic, payload](std::vector<uint8_t> &) {
+        return simpleble_peripheral_write_command(
+            handle, service, characteristic, payload.data(), payload.size());
+      },
+      "Write failed", false);
+}
+
+Napi::Value Attribute::Notify(const Napi::CallbackInfo &info) {
+  return Subscribe(info, false, false);
+}
+
+Napi::Value Attribute::NotifyBatched(const Napi::CallbackInfo &info) {
+  return Subscribe(info, false, true);
+}
+
+Napi::Value Attribute::Indicate(const Napi::CallbackInfo &info) {
+  return Subscribe(info, true, false);
+}
+
+Napi::Value Attribute::Subscribe(const Napi::CallbackInfo &info, bool indicate,
+                                 bool batched) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  if (!RequireCharacteristic(env)) {
+    return env.Undefined();
+  }
+
+  // Batched subscriptions take their options first, as notifyBatched does
+  const size_t callbackIndex = batched ? 1 : 0;
+  const size_t optionsIndex = batched ? 0 : 1;
+
+  if (batched && (info.Length() < 1 || !info[0].IsObject())) {
+    Napi::TypeError::New(env, "Options is not an object")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() <= callbackIndex) {
+    Napi::TypeError::New(env, "Missing callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[callbackIndex].IsFunction()) {
+    Napi::TypeError::New(env, "Callback is not a function")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Subscription::Options options;
+  if (batched) {
+    if (!Subscription::ParseBatchOptions(env, info[0].As<Napi::Object>(),
+                                         options)) {
+      return env.Undefined();
+    }
+  } else if (info.Length() > optionsIndex && info[optionsIndex].IsObject() &&
+             !Subscription::ParseOptions(
+                 env, info[optionsIndex].As<Napi::Object>(), options)) {
+    return env.Undefined();
+  }
+
+  const auto mode =
+      batched ? Subscription::Mode::Batched : Subscription::Mode::Plain;
+  if (!this->peripheral->CheckMode(env, this->characteristic, indicate,
+                                   mode)) {
+    return env.Undefined();
+  }
+
+  const auto callback = info[callbackIndex].As<Napi::Function>();
+  if (this->peripheral->Join(this->characteristic, indicate, batched,
+                             callback)) {
+    return Napi::Boolean::New(env, true);
+  }
+
+  const char *name =
+      indicate ? "onIndicate" : (batched ? "onNotifyBatched" : "onNotify");
+  auto subscription = Subscription::New(env, callback, name, options);
+  const auto ret = this->peripheral->Subscribe(
+      this->service, this->characteristic, indicate, subscription);
+
+  return Napi::Boolean::New(env, ret);
+}
+
+Napi::Value Attribute::Unsubscribe(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!RequireCharacteristic(env)) {
+    return env.Undefined();
+  }
+
+  Napi::Function callback;
+  if (info.Length() > 0 && info[0].IsFunction()) {
+    callback = info[0].As<Napi::Function>();
+  }
+
+  const auto ret = this->peripheral->Unsubscribe(
+      this->service, this->characteristic, callback);
+  return Napi::Boolean::New(env, ret);
+}
+
+bool Attribute::RequireCharacteristic(Napi::Env env) {
+  if (this->isDescriptor) {
+    Napi::TypeError::New(env, "Not supported on a descriptor")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "peripheral.h"
+#include <napi.h>
+#include <simpleble_c/peripheral.h>
+
+// A characteristic or descriptor resolved once from its UUIDs, so repeated
+// operations skip string marshalling. Holds a strong reference to its
+// peripheral and shares its operation queue and subscriptions.
+class Attribute : public Napi::ObjectWrap<Attribute> {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+  Attribute(const Napi::CallbackInfo &info);
+
+private:
+  Peripheral *peripheral = nullptr;
+  Napi::ObjectReference owner;
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  simpleble_uuid_t descriptor;
+  bool isDescriptor = false;
+
+  Napi::Value Service(const Napi::CallbackInfo &info);
+  Napi::Value Characteristic(const Napi::CallbackInfo &info);
+  Napi::Value Descriptor(const Napi::CallbackInfo &info);
+  Napi::Value Read(const Napi::CallbackInfo &info);
+  Napi::Value ReadAsync(const Napi::CallbackInfo &info);
+  Napi::Value WriteRequest(const Napi::CallbackInfo &info);
+  Napi::Value WriteRequestAsync(const Napi::CallbackInfo &info);
+  Napi::Value WriteCommand(const Napi::CallbackInfo &info);
+  Napi::Value WriteCommandAsync(const Napi::CallbackInfo &info);
+  Napi::Value Notify(const Napi::CallbackInfo &info);
+  Napi::Value NotifyBatched(const Napi::CallbackInfo &info);
+  Napi::Value Indicate(const Napi::CallbackInfo &info);
+  Napi::Value Unsubscribe(const Napi::CallbackInfo &info);
+
+  Napi::Value Subscribe(const Napi::CallbackInfo &info, bool indicate,
+                        bool batched);
+  // Throws and returns false for operations a descriptor doesn't support
+  bool RequireCharacteristic(Napi::Env env);
+};
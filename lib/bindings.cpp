@@ -1,26 +1,58 @@
 #include <cstdio>
 #include <napi.h>
 #include <simpleble_c/simpleble.h>
+#include <vector>
 
 #include "adapter.h"
+#include "addon.h"
+#include "attribute.h"
+#include "metrics.h"
 #include "peripheral.h"
 
+#ifdef SIMPLEBLE_NODE_SIMULATOR
+#include "simulator/bindings.h"
+#endif
+
+// Adapter wrappers are created once, so every call hands back the same
+// objects along with their scan callbacks, filters and connections
 Napi::Value GetAdapters(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
+  auto data = AddonData::Get(env);
+  auto &adapterCache = data->adapters;
 
   const size_t count = simpleble_adapter_get_count();
 
+  // A dongle plugged in or removed shifts the indices, start again
+  if (count != adapterCache.size()) {
+    for (auto &adapter : adapterCache) {
+      adapter.Reset();
+    }
+    adapterCache.clear();
+
+    for (size_t i = 0; i < count; i++) {
+      adapterCache.push_back(Napi::Persistent(
+          data->adapterConstructor.New({Napi::Number::New(env, i)})));
+    }
+  }
+
   Napi::Array adapters = Napi::Array::New(env, count);
 
   for (size_t i = 0; i < count; i++) {
-    Napi::Value adapterInstance =
-        Adapter::constructor.New({Napi::Number::New(env, i)});
-    adapters.Set(i, adapterInstance);
+    // Released adapters are replaced by a fresh wrapper
+    if (adapterCache[i].IsEmpty()) {
+      adapterCache[i] = Napi::Persistent(
+          data->adapterConstructor.New({Napi::Number::New(env, i)}));
+    }
+    adapters.Set(i, adapterCache[i].Value());
   }
 
   return adapters;
 }
 
+Napi::Value GetMetrics(const Napi::CallbackInfo &info) {
+  return Metrics::Collect(info.Env());
+}
+
 Napi::Value IsEnabled(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
@@ -29,10 +61,28 @@ Napi::Value IsEnabled(const Napi::CallbackInfo &info) {
 }
 
 static Napi::Object Init(Napi::Env env, Napi::Object exports) {
+  // Each environment that loads the addon gets its own constructors and
+  // adapters, freed with the environment
+  auto data = new AddonData();
+  env.SetInstanceData(data);
+  env.AddCleanupHook([data] {
+    for (auto adapter : data->live) {
+      adapter->Shutdown();
+    }
+    for (auto peripheral : data->subscribed) {
+      peripheral->Shutdown();
+    }
+  });
+
   Adapter::Init(env, exports);
   Peripheral::Init(env, exports);
+  Attribute::Init(env, exports);
   exports.Set("getAdapters", Napi::Function::New(env, GetAdapters));
   exports.Set("isEnabled", Napi::Function::New(env, IsEnabled));
+  exports.Set("getMetrics", Napi::Function::New(env, GetMetrics));
+#ifdef SIMPLEBLE_NODE_SIMULATOR
+  simulator::Init(env, exports);
+#endif
 
   return exports;
 }
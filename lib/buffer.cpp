@@ -0,0 +1,83 @@
+#include "buffer.h"
+#include "simpleble_c/simpleble.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Below this size copying is cheaper than a finalized external buffer
+static constexpr size_t EXTERNAL_THRESHOLD = 256;
+
+Payload *Payload::Create(const uint8_t *data, size_t length) {
+  void *block = std::malloc(sizeof(Payload) + length);
+  if (block == nullptr) {
+    return nullptr;
+  }
+
+  auto payload = new (block) Payload{length, 0};
+  if (length > 0) {
+    std::memcpy(payload->Data(), data, length);
+  }
+  return payload;
+}
+
+void Payload::Free(Payload *payload) { std::free(payload); }
+
+Napi::Uint8Array Payload::Release(Napi::Env env) {
+  const size_t length = this->length;
+
+#ifdef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+  // Runtimes with a V8 sandbox reject external backing stores
+  auto arrayBuffer = Napi::ArrayBuffer::New(env, length);
+  std::memcpy(arrayBuffer.Data(), Data(), length);
+  Free(this);
+#else
+  auto arrayBuffer = Napi::ArrayBuffer::New(
+      env, Data(), length,
+      [](Napi::Env, void *, Payload *payload) { Free(payload); }, this);
+#endif
+
+  return Napi::Uint8Array::New(env, length, arrayBuffer, 0);
+}
+
+Napi::Uint8Array CopyBuffer(Napi::Env env, const uint8_t *data,
+                            size_t length) {
+  auto arrayBuffer = Napi::ArrayBuffer::New(env, length);
+  if (length > 0) {
+    std::memcpy(arrayBuffer.Data(), data, length);
+  }
+  return Napi::Uint8Array::New(env, length, arrayBuffer, 0);
+}
+
+Napi::Uint8Array AdoptBuffer(Napi::Env env, uint8_t *data, size_t length) {
+#ifndef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+  if (data != nullptr && length >= EXTERNAL_THRESHOLD) {
+    auto arrayBuffer =
+        Napi::ArrayBuffer::New(env, data, length, [](Napi::Env, void *block) {
+          simpleble_free(block);
+        });
+    return Napi::Uint8Array::New(env, length, arrayBuffer, 0);
+  }
+#endif
+
+  auto array = CopyBuffer(env, data, length);
+  simpleble_free(data);
+  return array;
+}
+
+Napi::Uint8Array AdoptBuffer(Napi::Env env, std::vector<uint8_t> &&data) {
+  const size_t length = data.size();
+
+#ifndef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+  if (length >= EXTERNAL_THRESHOLD) {
+    auto block = new std::vector<uint8_t>(std::move(data));
+    auto arrayBuffer = Napi::ArrayBuffer::New(
+        env, block->data(), length,
+        [](Napi::Env, void *, std::vector<uint8_t> *block) { delete block; },
+        block);
+    return Napi::Uint8Array::New(env, length, arrayBuffer, 0);
+  }
+#endif
+
+  return CopyBuffer(env, data.data(), length);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <napi.h>
+#include <vector>
+
+// A payload captured on a SimpleBLE thread, stored as a single heap block with
+// the data directly after the header. The block is handed to JS as the backing
+// store of an external ArrayBuffer, so a notification costs one allocation and
+// one copy end to end.
+struct Payload {
+  size_t length;
+  // Time of receipt in milliseconds since the epoch
+  double timestamp;
+
+  static Payload *Create(const uint8_t *data, size_t length);
+  static void Free(Payload *payload);
+
+  uint8_t *Data() { return reinterpret_cast<uint8_t *>(this + 1); }
+
+  // Transfers ownership of the block to JS, the payload must not be used
+  // afterwards.
+  Napi::Uint8Array Release(Napi::Env env);
+};
+
+// Returns a Uint8Array holding a copy of the bytes, made with one allocation
+// and one memcpy rather than element by element.
+Napi::Uint8Array CopyBuffer(Napi::Env env, const uint8_t *data, size_t length);
+
+// Takes ownership of a buffer allocated by SimpleBLE, which is released with
+// simpleble_free. Large buffers back the returned array directly, small ones
+// are copied as an external backing store costs more than the copy.
+Napi::Uint8Array AdoptBuffer(Napi::Env env, uint8_t *data, size_t length);
+
+// Takes ownership of the bytes in a vector, with the same size rule.
+Napi::Uint8Array AdoptBuffer(Napi::Env env, std::vector<uint8_t> &&data);
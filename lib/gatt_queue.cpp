@@ -0,0 +1,146 @@
+#include "gatt_queue.h"
+#include "buffer.h"
+
+#include <cstring>
+
+GattQueue::~GattQueue() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->ready.notify_one();
+
+  if (this->thread.joinable()) {
+    this->thread.join();
+  }
+
+  if (this->settleFn) {
+    this->settleFn.Release();
+  }
+}
+
+Napi::Promise GattQueue::Push(Napi::Env env, Napi::Object owner,
+                              Operation operation, const char *error,
+                              bool hasData) {
+  std::vector<Operation> operations;
+  operations.push_back(std::move(operation));
+  return Enqueue(env, owner, std::move(operations), error, hasData, false);
+}
+
+Napi::Promise GattQueue::PushMany(Napi::Env env, Napi::Object owner,
+                                  std::vector<Operation> operations,
+                                  const char *error, bool hasData) {
+  return Enqueue(env, owner, std::move(operations), error, hasData, true);
+}
+
+Napi::Promise GattQueue::Enqueue(Napi::Env env, Napi::Object owner,
+                                 std::vector<Operation> operations,
+                                 const char *error, bool hasData, bool many) {
+  if (!this->settleFn) {
+    this->settleFn = SettleFn::New(env, "GattQueue", 0, 1, this);
+    this->settleFn.Unref(env);
+    this->thread = std::thread(&GattQueue::Run, this);
+  }
+
+  const size_t count = operations.size();
+  auto job = new Job{std::move(operations),
+                     Napi::Promise::Deferred::New(env),
+                     Napi::Persistent(owner),
+                     this->metrics,
+                     error,
+                     hasData,
+                     many,
+                     std::vector<simpleble_err_t>(count, SIMPLEBLE_SUCCESS),
+                     std::vector<std::vector<uint8_t>>(count)};
+  auto promise = job->deferred.Promise();
+
+  // Keep the event loop alive while operations are outstanding
+  if (this->inFlight++ == 0) {
+    this->settleFn.Ref(env);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->jobs.push_back(job);
+  }
+  this->ready.notify_one();
+
+  return promise;
+}
+
+void GattQueue::Run() {
+  while (true) {
+    Job *job;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->ready.wait(lock,
+                       [this] { return this->stopping || !this->jobs.empty(); });
+      if (this->jobs.empty()) {
+        return;
+      }
+      job = this->jobs.front();
+      this->jobs.pop_front();
+    }
+
+    for (size_t i = 0; i < job->operations.size(); i++) {
+      auto run = [job, i] { return job->operations[i](job->data[i]); };
+      job->results[i] = job->metrics ? job->metrics->Time(run) : run();
+    }
+    this->settleFn.NonBlockingCall(job);
+  }
+}
+
+void GattQueue::Settle(Napi::Env env, Napi::Function, GattQueue *queue,
+                       Job *job) {
+  if (env == nullptr) {
+    // Environment is shutting down
+    delete job;
+    return;
+  }
+
+  if (job->many) {
+    SettleMany(env, job);
+  } else if (job->results[0] != SIMPLEBLE_SUCCESS) {
+    job->deferred.Reject(Napi::Error::New(env, job->error).Value());
+  } else if (job->hasData) {
+    job->deferred.Resolve(AdoptBuffer(env, std::move(job->data[0])));
+  } else {
+    job->deferred.Resolve(env.Undefined());
+  }
+  delete job;
+
+  if (--queue->inFlight == 0) {
+    queue->settleFn.Unref(env);
+  }
+}
+
+void GattQueue::SettleMany(Napi::Env env, Job *job) {
+  size_t total = 0;
+  for (const auto &data : job->data) {
+    total += data.size();
+  }
+
+  // One allocation for every payload, each result is a view into it
+  Napi::ArrayBuffer arrayBuffer;
+  if (job->hasData) {
+    arrayBuffer = Napi::ArrayBuffer::New(env, total);
+  }
+
+  Napi::Array results = Napi::Array::New(env, job->operations.size());
+  size_t offset = 0;
+  for (size_t i = 0; i < job->operations.size(); i++) {
+    const auto &data = job->data[i];
+    if (job->results[i] != SIMPLEBLE_SUCCESS) {
+      results[i] = Napi::Error::New(env, job->error).Value();
+    } else if (job->hasData) {
+      std::memcpy(static_cast<uint8_t *>(arrayBuffer.Data()) + offset,
+                  data.data(), data.size());
+      results[i] = Napi::Uint8Array::New(env, data.size(), arrayBuffer, offset);
+      offset += data.size();
+    } else {
+      results[i] = env.Undefined();
+    }
+  }
+
+  job->deferred.Resolve(results);
+}
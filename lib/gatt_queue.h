@@ -0,0 +1,77 @@
+#pragma once
+
+#include "metrics.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <simpleble_c/types.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Serialises the GATT operations of a single peripheral. Operations run one at
+// a time, in submission order, on a thread owned by the queue so a slow link
+// never delays another. Promises are settled on the JS thread in the same
+// order the operations were queued.
+class GattQueue {
+public:
+  using Operation = std::function<simpleble_err_t(std::vector<uint8_t> &)>;
+
+  GattQueue() = default;
+  ~GattQueue();
+
+  // Must be called from the JS thread. The owner is kept alive until the
+  // operation settles. Data filled in by the operation is resolved as a
+  // Uint8Array, otherwise the promise resolves with undefined.
+  Napi::Promise Push(Napi::Env env, Napi::Object owner, Operation operation,
+                     const char *error, bool hasData);
+
+  // As Push, running the operations back to back as one job. The promise
+  // resolves with an array holding, for each operation in order, its data or
+  // undefined, or an Error if it failed. Data shares a single ArrayBuffer.
+  Napi::Promise PushMany(Napi::Env env, Napi::Object owner,
+                         std::vector<Operation> operations, const char *error,
+                         bool hasData);
+
+  // Operations queued afterwards are timed into these metrics.
+  void SetMetrics(std::shared_ptr<Metrics> metrics) {
+    this->metrics = std::move(metrics);
+  }
+
+private:
+  struct Job {
+    std::vector<Operation> operations;
+    Napi::Promise::Deferred deferred;
+    Napi::ObjectReference owner;
+    std::shared_ptr<Metrics> metrics;
+    std::string error;
+    bool hasData;
+    bool many;
+    std::vector<simpleble_err_t> results;
+    std::vector<std::vector<uint8_t>> data;
+  };
+
+  Napi::Promise Enqueue(Napi::Env env, Napi::Object owner,
+                        std::vector<Operation> operations, const char *error,
+                        bool hasData, bool many);
+  static void SettleMany(Napi::Env env, Job *job);
+
+  static void Settle(Napi::Env env, Napi::Function, GattQueue *queue,
+                     Job *job);
+  using SettleFn = Napi::TypedThreadSafeFunction<GattQueue, Job, Settle>;
+
+  void Run();
+
+  SettleFn settleFn;
+  std::shared_ptr<Metrics> metrics;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<Job *> jobs;
+  bool stopping = false;
+  // Only touched on the JS thread
+  size_t inFlight = 0;
+};
@@ -0,0 +1,143 @@
+#include "metrics.h"
+#include "addon.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef SIMPLEBLE_NODE_METRICS
+
+void Histogram::Record(uint64_t value) {
+  size_t bucket = 0;
+  while (bucket < BUCKETS - 1 && (value >> bucket) != 0) {
+    bucket++;
+  }
+
+  this->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  this->count.fetch_add(1, std::memory_order_relaxed);
+  this->sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t max = this->max.load(std::memory_order_relaxed);
+  while (value > max && !this->max.compare_exchange_weak(
+                            max, value, std::memory_order_relaxed)) {
+  }
+}
+
+Napi::Object Histogram::ToObject(Napi::Env env) const {
+  uint64_t counts[BUCKETS];
+  uint64_t total = 0;
+  for (size_t i = 0; i < BUCKETS; i++) {
+    counts[i] = this->buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+
+  // Upper bound of the bucket holding the given fraction of values
+  auto percentile = [&](double fraction) -> double {
+    const uint64_t rank = uint64_t(double(total) * fraction);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+      if (seen > rank) {
+        return double(uint64_t(1) << i);
+      }
+    }
+    return 0;
+  };
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("count", double(total));
+  obj.Set("mean",
+          total > 0
+              ? double(this->sum.load(std::memory_order_relaxed)) / total
+              : 0);
+  obj.Set("p50", total > 0 ? percentile(0.5) : 0);
+  obj.Set("p99", total > 0 ? percentile(0.99) : 0);
+  obj.Set("max", double(this->max.load(std::memory_order_relaxed)));
+  return obj;
+}
+
+static void Prune(std::vector<std::weak_ptr<Metrics>> &registry) {
+  registry.erase(std::remove_if(registry.begin(), registry.end(),
+                                [](const std::weak_ptr<Metrics> &metrics) {
+                                  return metrics.expired();
+                                }),
+                 registry.end());
+}
+
+std::shared_ptr<Metrics> Metrics::New(Napi::Env env, const char *kind,
+                                      const std::string &id) {
+  auto metrics = std::make_shared<Metrics>();
+  metrics->kind = kind;
+  metrics->id = id;
+
+  auto &registry = AddonData::Get(env)->metrics;
+  // Amortised, expired entries are dropped whenever the registry doubles
+  if (registry.size() == registry.capacity()) {
+    Prune(registry);
+  }
+  registry.push_back(metrics);
+  return metrics;
+}
+
+Napi::Object Metrics::Collect(Napi::Env env) {
+  auto &registry = AddonData::Get(env)->metrics;
+  Prune(registry);
+  std::vector<std::shared_ptr<Metrics>> live;
+  for (auto &entry : registry) {
+    if (auto metrics = entry.lock()) {
+      live.push_back(metrics);
+    }
+  }
+
+  Napi::Array adapters = Napi::Array::New(env);
+  Napi::Array peripherals = Napi::Array::New(env);
+  for (auto &metrics : live) {
+    Napi::Array &list = metrics->kind == "adapter" ? adapters : peripherals;
+    list.Set(list.Length(), metrics->ToObject(env));
+  }
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("enabled", true);
+  obj.Set("adapters", adapters);
+  obj.Set("peripherals", peripherals);
+  return obj;
+}
+
+Napi::Object Metrics::ToObject(Napi::Env env) const {
+  Napi::Object gatt = this->gatt.ToObject(env);
+  gatt.Set("operations",
+           double(this->gattOperations.load(std::memory_order_relaxed)));
+  gatt.Set("failures",
+           double(this->gattFailures.load(std::memory_order_relaxed)));
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("id", this->id);
+  obj.Set("received", double(this->received.load(std::memory_order_relaxed)));
+  obj.Set("delivered",
+          double(this->delivered.load(std::memory_order_relaxed)));
+  obj.Set("queueDepth",
+          double(this->queueDepth.load(std::memory_order_relaxed)));
+  obj.Set("queueDepthMax",
+          double(this->queueDepthMax.load(std::memory_order_relaxed)));
+  obj.Set("dispatchLatency", this->dispatch.ToObject(env));
+  obj.Set("gatt", gatt);
+  return obj;
+}
+
+#else
+
+std::shared_ptr<Metrics> Metrics::New(Napi::Env, const char *,
+                                      const std::string &) {
+  // Stateless when collection is off, one instance serves everyone
+  static const auto metrics = std::make_shared<Metrics>();
+  return metrics;
+}
+
+Napi::Object Metrics::Collect(Napi::Env env) {
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("enabled", false);
+  obj.Set("adapters", Napi::Array::New(env));
+  obj.Set("peripherals", Napi::Array::New(env));
+  return obj;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+#include <simpleble_c/types.h>
+#include <string>
+
+#ifdef SIMPLEBLE_NODE_METRICS
+// Counts of values in power of two buckets of microseconds, bucket i holding
+// values below 2^i, so recording is a few relaxed atomics.
+class Histogram {
+public:
+  static constexpr size_t BUCKETS = 32;
+
+  void Record(uint64_t value);
+  // { count, mean, p50, p99, max }, percentiles are bucket upper bounds
+  Napi::Object ToObject(Napi::Env env) const;
+
+private:
+  std::atomic<uint64_t> buckets[BUCKETS] = {};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> max{0};
+};
+#endif
+
+// Hot path counters for an adapter or a peripheral: events received from
+// SimpleBLE and delivered to JS, the depth of the queue in between, the delay
+// from requesting a drain to it running on the JS thread, and GATT operation
+// durations and failures. Every update is a relaxed atomic, cheap enough for
+// the SimpleBLE threads. Instances are listed by getMetrics() in their own
+// environment while alive.
+//
+// Built without SIMPLEBLE_NODE_METRICS every method is empty and inline, so
+// collection compiles away entirely.
+class Metrics {
+public:
+  static std::shared_ptr<Metrics> New(Napi::Env env, const char *kind,
+                                      const std::string &id);
+
+  // { enabled, adapters, peripherals } for every instance alive in this
+  // environment.
+  static Napi::Object Collect(Napi::Env env);
+
+  // Monotonic microseconds, zero when collection is off.
+  static uint64_t Now() {
+#ifdef SIMPLEBLE_NODE_METRICS
+    using namespace std::chrono;
+    return duration_cast<microseconds>(
+               steady_clock::now().time_since_epoch())
+        .count();
+#else
+    return 0;
+#endif
+  }
+
+  void Received(size_t count) {
+#ifdef SIMPLEBLE_NODE_METRICS
+    this->received.fetch_add(count, std::memory_order_relaxed);
+#endif
+  }
+
+  void Delivered(size_t count) {
+#ifdef SIMPLEBLE_NODE_METRICS
+    this->delivered.fetch_add(count, std::memory_order_relaxed);
+#endif
+  }
+
+  // Called by a drain with the depth it found, before emptying the queue.
+  void Queued(size_t depth) {
+#ifdef SIMPLEBLE_NODE_METRICS
+    this->queueDepth.store(depth, std::memory_order_relaxed);
+    uint64_t max = this->queueDepthMax.load(std::memory_order_relaxed);
+    while (depth > max && !this->queueDepthMax.compare_exchange_weak(
+                              max, depth, std::memory_order_relaxed)) {
+    }
+#endif
+  }
+
+  // Called by a drain requested at the given Now().
+  void Dispatched(uint64_t scheduled) {
+#ifdef SIMPLEBLE_NODE_METRICS
+    const uint64_t now = Now();
+    this->dispatch.Record(now > scheduled ? now - scheduled : 0);
+#endif
+  }
+
+  // Runs a GATT operation, recording its duration and any failure.
+  template <typename F> simpleble_err_t Time(F operation) {
+#ifdef SIMPLEBLE_NODE_METRICS
+    const uint64_t start = Now();
+    const simpleble_err_t ret = operation();
+    this->gatt.Record(Now() - start);
+    this->gattOperations.fetch_add(1, std::memory_order_relaxed);
+    if (ret != SIMPLEBLE_SUCCESS) {
+      this->gattFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+    return ret;
+#else
+    return operation();
+#endif
+  }
+
+private:
+#ifdef SIMPLEBLE_NODE_METRICS
+  Napi::Object ToObject(Napi::Env env) const;
+
+  std::string kind;
+  std::string id;
+  std::atomic<uint64_t> received{0};
+  std::atomic<uint64_t> delivered{0};
+  std::atomic<uint64_t> queueDepth{0};
+  std::atomic<uint64_t> queueDepthMax{0};
+  Histogram dispatch;
+  std::atomic<uint64_t> gattOperations{0};
+  std::atomic<uint64_t> gattFailures{0};
+  Histogram gatt;
+#endif
+};
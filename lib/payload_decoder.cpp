@@ -0,0 +1,249 @@
+#include "payload_decoder.h"
+#include "buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static constexpr bool LITTLE_ENDIAN_HOST = false;
+#else
+static constexpr bool LITTLE_ENDIAN_HOST = true;
+#endif
+
+struct TypeInfo {
+  const char *name;
+  // Bytes in the payload and in the column
+  size_t size;
+  size_t width;
+};
+
+static const TypeInfo &Info(PayloadDecoder::Type type) {
+  static const TypeInfo types[] = {
+      {"int8", 1, 1},    {"uint8", 1, 1},  {"int16", 2, 2},
+      {"uint16", 2, 2},  {"int24", 3, 4},  {"uint24", 3, 4},
+      {"int32", 4, 4},   {"uint32", 4, 4}, {"float32", 4, 4},
+      {"float64", 8, 8},
+  };
+  return types[size_t(type)];
+}
+
+// Copies a little endian value of the column's width out of every row
+template <size_t Width>
+static void DecodeColumn(const uint8_t *src, size_t stride, size_t rows,
+                         uint8_t *dst) {
+  if (LITTLE_ENDIAN_HOST && stride == Width) {
+    std::memcpy(dst, src, rows * Width);
+    return;
+  }
+
+  for (size_t row = 0; row < rows; row++, src += stride, dst += Width) {
+    for (size_t i = 0; i < Width; i++) {
+      dst[i] = src[LITTLE_ENDIAN_HOST ? i : Width - 1 - i];
+    }
+  }
+}
+
+static void DecodeColumn24(const uint8_t *src, size_t stride, size_t rows,
+                           bool sign, uint8_t *dst) {
+  for (size_t row = 0; row < rows; row++, src += stride, dst += 4) {
+    uint32_t value = uint32_t(src[0]) | uint32_t(src[1]) << 8 |
+                     uint32_t(src[2]) << 16;
+    if (sign && (value & 0x800000)) {
+      value |= 0xff000000;
+    }
+    std::memcpy(dst, &value, sizeof(value));
+  }
+}
+
+template <typename T>
+static Napi::Value Column(Napi::Env env, std::vector<uint8_t> &&bytes) {
+  const size_t length = bytes.size() / sizeof(T);
+  const auto array = AdoptBuffer(env, std::move(bytes));
+  return Napi::TypedArrayOf<T>::New(env, length, array.ArrayBuffer(),
+                                    array.ByteOffset());
+}
+
+bool PayloadDecoder::Parse(Napi::Env env, Napi::Object layout,
+                           PayloadDecoder &decoder) {
+  if (!layout.Get("fields").IsArray()) {
+    Napi::TypeError::New(env, "Fields is not an array")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  const auto fields = layout.Get("fields").As<Napi::Array>();
+  if (fields.Length() == 0) {
+    Napi::RangeError::New(env, "Layout has no fields")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  std::unordered_set<std::string> names;
+  size_t end = 0;
+  size_t offset = 0;
+  for (uint32_t i = 0; i < fields.Length(); i++) {
+    if (!fields.Get(i).IsObject()) {
+      Napi::TypeError::New(env, "Field is not an object")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    const auto obj = fields.Get(i).As<Napi::Object>();
+
+    if (!obj.Get("name").IsString()) {
+      Napi::TypeError::New(env, "Field name is not a string")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    const std::string name = obj.Get("name").As<Napi::String>().Utf8Value();
+    if (!names.insert(name).second) {
+      Napi::RangeError::New(env, "Duplicate field " + name)
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+
+    const std::string typeName =
+        obj.Get("type").IsString()
+            ? obj.Get("type").As<Napi::String>().Utf8Value()
+            : std::string();
+    size_t type = 0;
+    while (type <= size_t(Type::Float64) &&
+           typeName != Info(Type(type)).name) {
+      type++;
+    }
+    if (type > size_t(Type::Float64)) {
+      Napi::RangeError::New(env, "Unknown type for field " + name)
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+
+    if (obj.Get("offset").IsNumber()) {
+      const auto value = obj.Get("offset").As<Napi::Number>().Int64Value();
+      if (value < 0) {
+        Napi::RangeError::New(env, "Offset must be at least 0")
+            .ThrowAsJavaScriptException();
+        return false;
+      }
+      offset = size_t(value);
+    }
+
+    decoder.fields.push_back({name, Type(type), offset});
+    offset += Info(Type(type)).size;
+    end = std::max(end, offset);
+  }
+
+  decoder.stride = end;
+  if (layout.Get("stride").IsNumber()) {
+    const auto stride = layout.Get("stride").As<Napi::Number>().Int64Value();
+    if (stride < int64_t(end)) {
+      Napi::RangeError::New(env, "Stride must be at least " +
+                                     std::to_string(end))
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    decoder.stride = size_t(stride);
+  }
+
+  return true;
+}
+
+PayloadDecoder::Columns PayloadDecoder::Allocate(size_t rows) const {
+  Columns columns;
+  columns.timestamps.reserve(rows * sizeof(double));
+  columns.fields.resize(this->fields.size());
+  for (size_t i = 0; i < this->fields.size(); i++) {
+    columns.fields[i].reserve(rows * Info(this->fields[i].type).width);
+  }
+  return columns;
+}
+
+void PayloadDecoder::Decode(const uint8_t *data, size_t length,
+                            double timestamp, Columns &columns) const {
+  const size_t rows = Rows(length);
+  columns.payloads++;
+  if (rows == 0) {
+    return;
+  }
+
+  const size_t first = columns.timestamps.size();
+  columns.timestamps.resize(first + rows * sizeof(double));
+  for (size_t row = 0; row < rows; row++) {
+    std::memcpy(&columns.timestamps[first + row * sizeof(double)], &timestamp,
+                sizeof(double));
+  }
+
+  for (size_t i = 0; i < this->fields.size(); i++) {
+    const Field &field = this->fields[i];
+    auto &column = columns.fields[i];
+    const size_t width = Info(field.type).width;
+    const size_t start = column.size();
+    column.resize(start + rows * width);
+
+    const uint8_t *src = data + field.offset;
+    uint8_t *dst = &column[start];
+    switch (width) {
+    case 1:
+      DecodeColumn<1>(src, this->stride, rows, dst);
+      break;
+    case 2:
+      DecodeColumn<2>(src, this->stride, rows, dst);
+      break;
+    case 4:
+      if (field.type == Type::Int24 || field.type == Type::Uint24) {
+        DecodeColumn24(src, this->stride, rows, field.type == Type::Int24,
+                       dst);
+      } else {
+        DecodeColumn<4>(src, this->stride, rows, dst);
+      }
+      break;
+    default:
+      DecodeColumn<8>(src, this->stride, rows, dst);
+      break;
+    }
+  }
+
+  columns.rows += rows;
+}
+
+Napi::Object PayloadDecoder::ToJS(Napi::Env env, Columns &&columns) const {
+  Napi::Object batch = Napi::Object::New(env);
+  batch.Set("count", double(columns.rows));
+  batch.Set("timestamp", Column<double>(env, std::move(columns.timestamps)));
+
+  Napi::Object values = Napi::Object::New(env);
+  for (size_t i = 0; i < this->fields.size(); i++) {
+    auto &bytes = columns.fields[i];
+    Napi::Value column;
+    switch (this->fields[i].type) {
+    case Type::Int8:
+      column = Column<int8_t>(env, std::move(bytes));
+      break;
+    case Type::Uint8:
+      column = AdoptBuffer(env, std::move(bytes));
+      break;
+    case Type::Int16:
+      column = Column<int16_t>(env, std::move(bytes));
+      break;
+    case Type::Uint16:
+      column = Column<uint16_t>(env, std::move(bytes));
+      break;
+    case Type::Int24:
+    case Type::Int32:
+      column = Column<int32_t>(env, std::move(bytes));
+      break;
+    case Type::Uint24:
+    case Type::Uint32:
+      column = Column<uint32_t>(env, std::move(bytes));
+      break;
+    case Type::Float32:
+      column = Column<float>(env, std::move(bytes));
+      break;
+    case Type::Float64:
+      column = Column<double>(env, std::move(bytes));
+      break;
+    }
+    values.Set(this->fields[i].name, column);
+  }
+  batch.Set("columns", values);
+  return batch;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+// Decodes fixed layout payloads, such as packed sensor samples, into one
+// column per field so JS receives typed arrays rather than a DataView call per
+// value. A payload holds as many records of `stride` bytes as fit, each
+// becoming a row, and trailing bytes are ignored. Values are little endian as
+// on the wire, 24 bit fields widen to 32 bits.
+//
+// Columns are decoded a field at a time across every row of a payload, a
+// tight fixed stride loop the compiler can vectorize, and a field packed with
+// no gaps on a little endian host is a single copy.
+class PayloadDecoder {
+public:
+  enum class Type {
+    Int8,
+    Uint8,
+    Int16,
+    Uint16,
+    Int24,
+    Uint24,
+    Int32,
+    Uint32,
+    Float32,
+    Float64,
+  };
+
+  struct Field {
+    std::string name;
+    Type type;
+    size_t offset;
+  };
+
+  // Decoded rows, one buffer per field in layout order and the time each
+  // row's payload was received
+  struct Columns {
+    std::vector<uint8_t> timestamps;
+    std::vector<std::vector<uint8_t>> fields;
+    size_t rows = 0;
+    size_t payloads = 0;
+  };
+
+  // Reads { fields: [{ name, type, offset? }], stride? } from a JS object,
+  // throwing on invalid layouts. Fields without an offset follow the previous
+  // one and the stride defaults to the end of the last field.
+  static bool Parse(Napi::Env env, Napi::Object layout,
+                    PayloadDecoder &decoder);
+
+  size_t Rows(size_t length) const { return length / this->stride; }
+
+  // Returns empty columns with room for `rows` rows.
+  Columns Allocate(size_t rows) const;
+
+  // Appends every row of a payload.
+  void Decode(const uint8_t *data, size_t length, double timestamp,
+              Columns &columns) const;
+
+  // Hands the columns to JS as { count, timestamp, columns: { name: array } }.
+  Napi::Object ToJS(Napi::Env env, Columns &&columns) const;
+
+private:
+  std::vector<Field> fields;
+  size_t stride = 0;
+};
@@ -1,7 +1,106 @@
 #include "peripheral.h"
+#include "addon.h"
+#include "attribute.h"
+#include "buffer.h"
 #include "simpleble_c/simpleble.h"
+#include "write_stream.h"
 
-Napi::FunctionReference Peripheral::constructor;
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+bool GetUuidArg(const Napi::CallbackInfo &info, size_t index, const char *name,
+                simpleble_uuid_t &uuid) {
+  Napi::Env env = info.Env();
+  std::string label(name);
+  label[0] = toupper(label[0]);
+
+  if (info.Length() <= index) {
+    Napi::TypeError::New(env, "Missing " + std::string(name))
+        .ThrowAsJavaScriptException();
+    return false;
+  } else if (!info[index].IsString()) {
+    Napi::TypeError::New(env, label + " is not a string")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  const std::string value = info[index].As<Napi::String>().Utf8Value();
+  memset(uuid.value, 0, SIMPLEBLE_UUID_STR_LEN);
+  memcpy(uuid.value, value.c_str(),
+         std::min(value.size(), size_t(SIMPLEBLE_UUID_STR_LEN - 1)));
+  return true;
+}
+
+bool GetDataArg(const Napi::CallbackInfo &info, size_t index,
+                std::vector<uint8_t> &data) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() <= index) {
+    Napi::TypeError::New(env, "Missing data").ThrowAsJavaScriptException();
+    return false;
+  } else if (!info[index].IsTypedArray()) {
+    Napi::TypeError::New(env, "Invalid data").ThrowAsJavaScriptException();
+    return false;
+  }
+
+  // Copied, the source array may be collected or mutated while queued
+  const auto array = info[index].As<Napi::Uint8Array>();
+  data.assign(array.Data(), array.Data() + array.ByteLength());
+  return true;
+}
+
+// One (service, characteristic[, data]) entry of a bulk operation
+struct BulkEntry {
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  std::vector<uint8_t> data;
+};
+
+// Reads an array of [service, characteristic] entries, each followed by a
+// Uint8Array when withData is set. Throws and returns false on invalid input.
+static bool GetBulkEntries(Napi::Env env, Napi::Value value, bool withData,
+                           std::vector<BulkEntry> &entries) {
+  if (!value.IsArray()) {
+    Napi::TypeError::New(env, "Entries is not an array")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  const Napi::Array array = value.As<Napi::Array>();
+  entries.resize(array.Length());
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    const Napi::Value item = array.Get(i);
+    const Napi::Array entry =
+        item.IsArray() ? item.As<Napi::Array>() : Napi::Array::New(env);
+    const Napi::Value service = entry.Get(uint32_t(0));
+    const Napi::Value characteristic = entry.Get(uint32_t(1));
+    const Napi::Value data = entry.Get(uint32_t(2));
+    if (!service.IsString() || !characteristic.IsString() ||
+        (withData && !data.IsTypedArray())) {
+      Napi::TypeError::New(env, "Invalid entry at index " + std::to_string(i))
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+
+    BulkEntry &bulk = entries[i];
+    const std::string s = service.As<Napi::String>().Utf8Value();
+    const std::string c = characteristic.As<Napi::String>().Utf8Value();
+    memset(bulk.service.value, 0, SIMPLEBLE_UUID_STR_LEN);
+    memcpy(bulk.service.value, s.c_str(),
+           std::min(s.size(), size_t(SIMPLEBLE_UUID_STR_LEN - 1)));
+    memset(bulk.characteristic.value, 0, SIMPLEBLE_UUID_STR_LEN);
+    memcpy(bulk.characteristic.value, c.c_str(),
+           std::min(c.size(), size_t(SIMPLEBLE_UUID_STR_LEN - 1)));
+
+    if (withData) {
+      const auto payload = data.As<Napi::Uint8Array>();
+      bulk.data.assign(payload.Data(), payload.Data() + payload.ByteLength());
+    }
+  }
+
+  return true;
+}
 
 Napi::Object Peripheral::Init(Napi::Env env, Napi::Object exports) {
   // clang-format off
@@ -18,23 +117,39 @@ Napi::Object Peripheral::Init(Napi::Env env, Napi::Object exports) {
     InstanceAccessor<&Peripheral::GetServices>("services"),
     InstanceAccessor<&Peripheral::GetManufacturerData>("manufacturerData"),
     InstanceMethod("connect", &Peripheral::Connect),
+    InstanceMethod("connectAsync", &Peripheral::ConnectAsync),
     InstanceMethod("disconnect", &Peripheral::Disconnect),
+    InstanceMethod("disconnectAsync", &Peripheral::DisconnectAsync),
     InstanceMethod("unpair", &Peripheral::Unpair),
+    InstanceMethod("invalidateServices", &Peripheral::InvalidateServices),
+    InstanceMethod("servicesCacheStats", &Peripheral::ServicesCacheStats),
     InstanceMethod("read", &Peripheral::Read),
+    InstanceMethod("readAsync", &Peripheral::ReadAsync),
+    InstanceMethod("readMany", &Peripheral::ReadMany),
     InstanceMethod("writeRequest", &Peripheral::WriteRequest),
+    InstanceMethod("writeRequestAsync", &Peripheral::WriteRequestAsync),
     InstanceMethod("writeCommand", &Peripheral::WriteCommand),
+    InstanceMethod("writeCommandAsync", &Peripheral::WriteCommandAsync),
+    InstanceMethod("writeMany", &Peripheral::WriteMany),
+    InstanceMethod("writeStream", &Peripheral::WriteStream),
     InstanceMethod("notify", &Peripheral::Notify),
+    InstanceMethod("notifyBatched", &Peripheral::NotifyBatched),
+    InstanceMethod("notifyDecoded", &Peripheral::NotifyDecoded),
+    InstanceMethod("notifyShared", &Peripheral::NotifyShared),
     InstanceMethod("indicate", &Peripheral::Indicate),
     InstanceMethod("unsubscribe", &Peripheral::Unsubscribe),
+    InstanceMethod("attribute", &Peripheral::GetAttribute),
+    InstanceMethod("subscriptionStats", &Peripheral::SubscriptionStats),
     InstanceMethod("readDescriptor", &Peripheral::ReadDescriptor),
+    InstanceMethod("readDescriptorAsync", &Peripheral::ReadDescriptorAsync),
     InstanceMethod("writeDescriptor", &Peripheral::WriteDescriptor),
+    InstanceMethod("writeDescriptorAsync", &Peripheral::WriteDescriptorAsync),
     InstanceMethod("setCallbackOnConnected", &Peripheral::SetCallbackOnConnected),
     InstanceMethod("setCallbackOnDisconnected", &Peripheral::SetCallbackOnDisconnected),
   });
   // clang-format on
 
-  constructor = Napi::Persistent(func);
-  constructor.SuppressDestruct();
+  AddonData::Get(env)->peripheralConstructor = Napi::Persistent(func);
 
   exports.Set("Peripheral", func);
   return exports;
@@ -66,12 +181,26 @@ Peripheral::Peripheral(const Napi::CallbackInfo &info)
 #include <iostream>
 
 Peripheral::~Peripheral() {
+  if (this->retained) {
+    AddonData::Get(Env())->subscribed.erase(this);
+  }
+
   if (this->handle != nullptr) {
+    // A subscribed peripheral is kept alive until it unsubscribes or the
+    // environment shuts down, so SimpleBLE no longer holds any subscription.
+    // Only the link callbacks still carry this peripheral as userdata, and a
+    // null callback is rejected, swap in one that ignores it.
+    const auto ignore = [](simpleble_peripheral_t, void *) {};
+    simpleble_peripheral_set_callback_on_connected(this->handle, ignore,
+                                                   nullptr);
+    simpleble_peripheral_set_callback_on_disconnected(this->handle, ignore,
+                                                      nullptr);
+
     simpleble_peripheral_release_handle(this->handle);
   }
 
-  for (auto [k, fn] : notifyFns) fn.Release();
-  for (auto [k, fn] : indicateFns) fn.Release();
+  for (auto [k, subscription] : notifications) subscription->Close();
+  for (auto [k, subscription] : indications) subscription->Close();
 
   if (this->onConnectedFn) {
     this->onConnectedFn.Release();
@@ -84,6 +213,35 @@ Peripheral::~Peripheral() {
   this->handle = nullptr;
 }
 
+void Peripheral::Shutdown() {
+  for (const auto &[key, service] : this->subscribedServices) {
+    simpleble_uuid_t characteristic;
+    memset(characteristic.value, 0, SIMPLEBLE_UUID_STR_LEN);
+    memcpy(characteristic.value, key.c_str(),
+           std::min(key.size(), size_t(SIMPLEBLE_UUID_STR_LEN - 1)));
+    simpleble_peripheral_unsubscribe(this->handle, service, characteristic);
+  }
+  this->subscribedServices.clear();
+}
+
+void Peripheral::UpdateRetained() {
+  const bool subscribed =
+      !this->notifications.empty() || !this->indications.empty();
+  if (subscribed == this->retained) {
+    return;
+  }
+
+  auto data = AddonData::Get(Env());
+  if (subscribed) {
+    Ref();
+    data->subscribed.insert(this);
+  } else {
+    Unref();
+    data->subscribed.erase(this);
+  }
+  this->retained = subscribed;
+}
+
 Napi::Value Peripheral::Identifier(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
@@ -134,17 +292,52 @@ Napi::Value Peripheral::MTU(const Napi::CallbackInfo &info) {
 Napi::Value Peripheral::Connect(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
-  const auto ret = simpleble_peripheral_connect(this->handle);
+  const auto ret = GetMetrics()->Time(
+      [this] { return simpleble_peripheral_connect(this->handle); });
+  this->servicesEpoch++;
   return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
 }
 
+Napi::Value Peripheral::ConnectAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  // The queue holds the wrapper until the operation settles
+  auto handle = this->handle;
+  auto epoch = &this->servicesEpoch;
+  return Queue().Push(
+      env, Value(),
+      [handle, epoch](std::vector<uint8_t> &) {
+        const auto ret = simpleble_peripheral_connect(handle);
+        (*epoch)++;
+        return ret;
+      },
+      "Connect failed", false);
+}
+
 Napi::Value Peripheral::Disconnect(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
-  const auto ret = simpleble_peripheral_disconnect(this->handle);
+  const auto ret = GetMetrics()->Time(
+      [this] { return simpleble_peripheral_disconnect(this->handle); });
+  this->servicesEpoch++;
   return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
 }
 
+Napi::Value Peripheral::DisconnectAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  auto handle = this->handle;
+  auto epoch = &this->servicesEpoch;
+  return Queue().Push(
+      env, Value(),
+      [handle, epoch](std::vector<uint8_t> &) {
+        const auto ret = simpleble_peripheral_disconnect(handle);
+        (*epoch)++;
+        return ret;
+      },
+      "Disconnect failed", false);
+}
+
 Napi::Value Peripheral::Connected(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
@@ -180,6 +373,67 @@ Napi::Value Peripheral::Unpair(const Napi::CallbackInfo &info) {
 Napi::Value Peripheral::GetServices(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
+  // Read before building, so a disconnect while building leaves the result
+  // stale rather than cached
+  const uint64_t epoch = this->servicesEpoch.load();
+
+  // Only a connected peripheral has a stable tree, advertised services change
+  // between reports
+  bool connected = false;
+  simpleble_peripheral_is_connected(this->handle, &connected);
+  if (!connected) {
+    this->servicesCache.Reset();
+  } else if (!this->servicesCache.IsEmpty() &&
+             this->servicesCacheEpoch == epoch) {
+    this->servicesCacheHits++;
+    return this->servicesCache.Value();
+  }
+
+  this->servicesCacheMisses++;
+  Napi::Array services = BuildServices(env);
+  if (connected) {
+    this->servicesCache = Napi::Persistent(services);
+    this->servicesCacheEpoch = epoch;
+  }
+  return services;
+}
+
+Napi::Value Peripheral::InvalidateServices(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  // SimpleBLE doesn't report Service Changed indications, callers that expect
+  // the tree to change invalidate it themselves
+  this->servicesEpoch++;
+  this->servicesCache.Reset();
+  return env.Undefined();
+}
+
+Napi::Value Peripheral::ServicesCacheStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("hits", double(this->servicesCacheHits));
+  obj.Set("misses", double(this->servicesCacheMisses));
+  return obj;
+}
+
+const std::shared_ptr<Metrics> &Peripheral::GetMetrics() {
+  if (!this->metrics) {
+    char *address = simpleble_peripheral_address(this->handle);
+    this->metrics = Metrics::New(Env(), "peripheral",
+                                 address != nullptr ? address : "");
+    simpleble_free(address);
+    this->queue.SetMetrics(this->metrics);
+  }
+  return this->metrics;
+}
+
+GattQueue &Peripheral::Queue() {
+  GetMetrics();
+  return this->queue;
+}
+
+Napi::Array Peripheral::BuildServices(Napi::Env env) {
   const size_t count = simpleble_peripheral_services_count(this->handle);
   Napi::Array services = Napi::Array::New(env, count);
 
@@ -194,10 +448,8 @@ Napi::Value Peripheral::GetServices(const Napi::CallbackInfo &info) {
     Napi::String uuid =
         Napi::String::New(env, service.uuid.value, SIMPLEBLE_UUID_STR_LEN_TS);
 
-    Napi::Uint8Array data = Napi::Uint8Array::New(env, service.data_length);
-    for (size_t i = 0; i < service.data_length; i++) {
-      data[i] = service.data[i];
-    }
+    Napi::Uint8Array data =
+        CopyBuffer(env, service.data, service.data_length);
 
     Napi::Array characteristics =
         Napi::Array::New(env, service.characteristic_count);
@@ -249,10 +501,7 @@ Napi::Value Peripheral::GetManufacturerData(const Napi::CallbackInfo &info) {
     }
 
     Napi::Uint8Array data =
-        Napi::Uint8Array::New(env, manufacturerData.data_length);
-    for (size_t i = 0; i < manufacturerData.data_length; i++) {
-      data[i] = manufacturerData.data[i];
-    }
+        CopyBuffer(env, manufacturerData.data, manufacturerData.data_length);
 
     uint16_t id = manufacturerData.manufacturer_id;
     obj[uint32_t(id)] = data;
@@ -296,18 +545,76 @@ Napi::Value Peripheral::Read(const Napi::CallbackInfo &info) {
   uint8_t *data_ptr = nullptr;
   size_t data_length;
 
-  auto ret = simpleble_peripheral_read(this->handle, service, characteristic,
-                                       &data_ptr, &data_length);
+  auto ret = GetMetrics()->Time([&] {
+    return simpleble_peripheral_read(this->handle, service, characteristic,
+                                     &data_ptr, &data_length);
+  });
   if (ret != SIMPLEBLE_SUCCESS) {
+    simpleble_free(data_ptr);
+    return env.Undefined();
+  }
+
+  return AdoptBuffer(env, data_ptr, data_length);
+}
+
+Napi::Value Peripheral::ReadAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic)) {
+    return env.Undefined();
+  }
+
+  auto handle = this->handle;
+  return Queue().Push(
+      env, Value(),
+      [handle, service, characteristic](std::vector<uint8_t> &data) {
+        uint8_t *data_ptr = nullptr;
+        size_t data_length = 0;
+
+        auto ret = simpleble_peripheral_read(handle, service, characteristic,
+                                             &data_ptr, &data_length);
+        if (ret == SIMPLEBLE_SUCCESS) {
+          data.assign(data_ptr, data_ptr + data_length);
+        }
+        simpleble_free(data_ptr);
+        return ret;
+      },
+      "Read failed", true);
+}
+
+Napi::Value Peripheral::ReadMany(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::vector<BulkEntry> entries;
+  if (!GetBulkEntries(env, info[0], false, entries)) {
     return env.Undefined();
   }
 
-  Napi::Uint8Array data = Napi::Uint8Array::New(env, data_length);
-  for (size_t i = 0; i < data_length; i++) {
-    data[i] = data_ptr[i];
+  auto handle = this->handle;
+  std::vector<GattQueue::Operation> operations;
+  operations.reserve(entries.size());
+  for (const auto &entry : entries) {
+    operations.push_back([handle, entry](std::vector<uint8_t> &data) {
+      uint8_t *data_ptr = nullptr;
+      size_t data_length = 0;
+
+      auto ret = simpleble_peripheral_read(handle, entry.service,
+                                           entry.characteristic, &data_ptr,
+                                           &data_length);
+      if (ret == SIMPLEBLE_SUCCESS) {
+        data.assign(data_ptr, data_ptr + data_length);
+      }
+      simpleble_free(data_ptr);
+      return ret;
+    });
   }
 
-  return data;
+  return Queue().PushMany(env, Value(), std::move(operations), "Read failed",
+                          true);
 }
 
 Napi::Value Peripheral::WriteRequest(const Napi::CallbackInfo &info) {
@@ -351,11 +658,36 @@ Napi::Value Peripheral::WriteRequest(const Napi::CallbackInfo &info) {
   memcpy(characteristic.value, cbChar.Utf8Value().c_str(),
          SIMPLEBLE_UUID_STR_LEN);
 
-  const auto ret = simpleble_peripheral_write_request(
-      this->handle, service, characteristic, data, data_size);
+  const auto ret = GetMetrics()->Time([&] {
+    return simpleble_peripheral_write_request(this->handle, service,
+                                              characteristic, data, data_size);
+  });
   return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
 }
 
+Napi::Value Peripheral::WriteRequestAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  std::vector<uint8_t> payload;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic) ||
+      !GetDataArg(info, 2, payload)) {
+    return env.Undefined();
+  }
+
+  auto handle = this->handle;
+  return Queue().Push(
+      env, Value(),
+      [handle, service, characteristic, payload](std::vector<uint8_t> &) {
+        return simpleble_peripheral_write_request(
+            handle, service, characteristic, payload.data(), payload.size());
+      },
+      "Write failed", false);
+}
+
 Napi::Value Peripheral::WriteCommand(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
@@ -397,11 +729,102 @@ Napi::Value Peripheral::WriteCommand(const Napi::CallbackInfo &info) {
   memcpy(characteristic.value, cbChar.Utf8Value().c_str(),
          SIMPLEBLE_UUID_STR_LEN);
 
-  const auto ret = simpleble_peripheral_write_command(
-      this->handle, service, characteristic, data, data_size);
+  const auto ret = GetMetrics()->Time([&] {
+    return simpleble_peripheral_write_command(this->handle, service,
+                                              characteristic, data, data_size);
+  });
   return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
 }
 
+Napi::Value Peripheral::WriteCommandAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  std::vector<uint8_t> payload;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic) ||
+      !GetDataArg(info, 2, payload)) {
+    return env.Undefined();
+  }
+
+  auto handle = this->handle;
+  return Queue().Push(
+      env, Value(),
+      [handle, service, characteristic, payload](std::vector<uint8_t> &) {
+        return simpleble_peripheral_write_command(
+            handle, service, characteristic, payload.data(), payload.size());
+      },
+      "Write failed", false);
+}
+
+Napi::Value Peripheral::WriteMany(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  std::vector<BulkEntry> entries;
+  if (!GetBulkEntries(env, info[0], true, entries)) {
+    return env.Undefined();
+  }
+  const bool command = info.Length() > 1 && info[1].ToBoolean();
+
+  auto handle = this->handle;
+  std::vector<GattQueue::Operation> operations;
+  operations.reserve(entries.size());
+  for (auto &entry : entries) {
+    operations.push_back(
+        [handle, command, entry = std::move(entry)](std::vector<uint8_t> &) {
+          return command ? simpleble_peripheral_write_command(
+                               handle, entry.service, entry.characteristic,
+                               entry.data.data(), entry.data.size())
+                         : simpleble_peripheral_write_request(
+                               handle, entry.service, entry.characteristic,
+                               entry.data.data(), entry.data.size());
+        });
+  }
+
+  return Queue().PushMany(env, Value(), std::move(operations), "Write failed",
+                          false);
+}
+
+Napi::Value Peripheral::WriteStream(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  std::vector<uint8_t> payload;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic) ||
+      !GetDataArg(info, 2, payload)) {
+    return env.Undefined();
+  }
+
+  ::WriteStream::Options options;
+  if (info.Length() > 3 && info[3].IsObject() &&
+      !::WriteStream::ParseOptions(env, info[3].As<Napi::Object>(), options)) {
+    return env.Undefined();
+  }
+
+  Napi::Function progress;
+  if (info.Length() > 4 && !info[4].IsUndefined()) {
+    if (!info[4].IsFunction()) {
+      Napi::TypeError::New(env, "Progress is not a function")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    progress = info[4].As<Napi::Function>();
+  }
+
+  // Owned by the job so the progress function is released with it
+  auto stream = std::make_shared<::WriteStream>(
+      env, this->handle, service, characteristic, std::move(payload), options,
+      progress);
+  return Queue().Push(
+      env, Value(), [stream](std::vector<uint8_t> &) { return stream->Run(); },
+      "Write failed", false);
+}
+
 Napi::Value Peripheral::Unsubscribe(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
@@ -432,9 +855,112 @@ Napi::Value Peripheral::Unsubscribe(const Napi::CallbackInfo &info) {
   memcpy(service.value, cbService.Utf8Value().c_str(), SIMPLEBLE_UUID_STR_LEN);
   memcpy(characteristic.value, cbChar.Utf8Value().c_str(),
          SIMPLEBLE_UUID_STR_LEN);
+
+  Napi::Function callback;
+  if (info.Length() > 2 && info[2].IsFunction()) {
+    callback = info[2].As<Napi::Function>();
+  }
+
+  return Napi::Boolean::New(env,
+                            Unsubscribe(service, characteristic, callback));
+}
+
+bool Peripheral::CheckMode(Napi::Env env, simpleble_uuid_t characteristic,
+                           bool indicate, Subscription::Mode mode) {
+  auto &subscriptions = indicate ? this->indications : this->notifications;
+  const auto it = subscriptions.find(characteristic.value);
+  if (it != subscriptions.end() && it->second->GetMode() != mode) {
+    Napi::TypeError::New(env, "Already subscribed in another mode")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
+}
+
+bool Peripheral::Join(simpleble_uuid_t characteristic, bool indicate,
+                      bool batched, Napi::Function callback) {
+  auto &subscriptions = indicate ? this->indications : this->notifications;
+  const auto it = subscriptions.find(characteristic.value);
+  if (it == subscriptions.end() || !it->second->Joinable(batched)) {
+    return false;
+  }
+
+  // Subscribing the same callback again is not a second subscriber
+  it->second->AddListener(callback);
+  return true;
+}
+
+bool Peripheral::Unsubscribe(simpleble_uuid_t service,
+                             simpleble_uuid_t characteristic,
+                             Napi::Function callback) {
+  const std::string key(characteristic.value);
+  bool subscribed = false;
+  for (auto subscriptions : {&this->notifications, &this->indications}) {
+    if (const auto it = subscriptions->find(key); it != subscriptions->end()) {
+      // Other subscribers keep the subscription and the CCCD
+      if (!callback.IsEmpty() && it->second->RemoveListener(callback) > 0) {
+        continue;
+      }
+      it->second->Close();
+      subscriptions->erase(it);
+      subscribed = true;
+    }
+  }
+
+  if (!this->notifications.count(key) && !this->indications.count(key)) {
+    this->subscribedServices.erase(key);
+  }
+  UpdateRetained();
+
+  // Nothing to tear down, skip the CCCD write
+  if (!subscribed) {
+    return true;
+  }
+
   const auto ret =
       simpleble_peripheral_unsubscribe(this->handle, service, characteristic);
-  return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
+  return ret == SIMPLEBLE_SUCCESS;
+}
+
+Napi::Value Peripheral::GetAttribute(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t uuid;
+  if (!GetUuidArg(info, 0, "service", uuid) ||
+      !GetUuidArg(info, 1, "characteristic", uuid)) {
+    return env.Undefined();
+  }
+
+  std::vector<napi_value> args = {Value(), info[0], info[1]};
+  if (info.Length() > 2 && !info[2].IsUndefined()) {
+    if (!GetUuidArg(info, 2, "descriptor", uuid)) {
+      return env.Undefined();
+    }
+    args.push_back(info[2]);
+  }
+
+  return AddonData::Get(env)->attributeConstructor.New(args);
+}
+
+Napi::Value Peripheral::SubscriptionStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic)) {
+    return env.Undefined();
+  }
+
+  const std::string key(characteristic.value);
+  for (auto subscriptions : {&this->notifications, &this->indications}) {
+    if (const auto it = subscriptions->find(key); it != subscriptions->end()) {
+      return it->second->Stats(env);
+    }
+  }
+
+  return env.Undefined();
 }
 
 Napi::Value Peripheral::ReadDescriptor(const Napi::CallbackInfo &info) {
@@ -485,19 +1011,50 @@ Napi::Value Peripheral::ReadDescriptor(const Napi::CallbackInfo &info) {
   uint8_t *data_ptr = nullptr;
   size_t data_length;
 
-  auto ret = simpleble_peripheral_read_descriptor(this->handle, service,
-                                                  characteristic, descriptor,
-                                                  &data_ptr, &data_length);
+  auto ret = GetMetrics()->Time([&] {
+    return simpleble_peripheral_read_descriptor(this->handle, service,
+                                                characteristic, descriptor,
+                                                &data_ptr, &data_length);
+  });
   if (ret != SIMPLEBLE_SUCCESS) {
+    simpleble_free(data_ptr);
     return env.Undefined();
   }
 
-  Napi::Uint8Array data = Napi::Uint8Array::New(env, data_length);
-  for (size_t i = 0; i < data_length; i++) {
-    data[i] = data_ptr[i];
+  return AdoptBuffer(env, data_ptr, data_length);
+}
+
+Napi::Value Peripheral::ReadDescriptorAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  simpleble_uuid_t descriptor;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic) ||
+      !GetUuidArg(info, 2, "descriptor", descriptor)) {
+    return env.Undefined();
   }
 
-  return data;
+  auto handle = this->handle;
+  return Queue().Push(
+      env, Value(),
+      [handle, service, characteristic,
+       descriptor](std::vector<uint8_t> &data) {
+        uint8_t *data_ptr = nullptr;
+        size_t data_length = 0;
+
+        auto ret = simpleble_peripheral_read_descriptor(
+            handle, service, characteristic, descriptor, &data_ptr,
+            &data_length);
+        if (ret == SIMPLEBLE_SUCCESS) {
+          data.assign(data_ptr, data_ptr + data_length);
+        }
+        simpleble_free(data_ptr);
+        return ret;
+      },
+      "Read failed", true);
 }
 
 Napi::Value Peripheral::WriteDescriptor(const Napi::CallbackInfo &info) {
@@ -554,11 +1111,40 @@ Napi::Value Peripheral::WriteDescriptor(const Napi::CallbackInfo &info) {
          SIMPLEBLE_UUID_STR_LEN);
   memcpy(descriptor.value, cbDesc.Utf8Value().c_str(), SIMPLEBLE_UUID_STR_LEN);
 
-  const auto ret = simpleble_peripheral_write_descriptor(
-      this->handle, service, characteristic, descriptor, data, data_size);
+  const auto ret = GetMetrics()->Time([&] {
+    return simpleble_peripheral_write_descriptor(
+        this->handle, service, characteristic, descriptor, data, data_size);
+  });
   return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
 }
 
+Napi::Value Peripheral::WriteDescriptorAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  simpleble_uuid_t descriptor;
+  std::vector<uint8_t> payload;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic) ||
+      !GetUuidArg(info, 2, "descriptor", descriptor) ||
+      !GetDataArg(info, 3, payload)) {
+    return env.Undefined();
+  }
+
+  auto handle = this->handle;
+  return Queue().Push(
+      env, Value(),
+      [handle, service, characteristic, descriptor,
+       payload](std::vector<uint8_t> &) {
+        return simpleble_peripheral_write_descriptor(
+            handle, service, characteristic, descriptor, payload.data(),
+            payload.size());
+      },
+      "Write failed", false);
+}
+
 Napi::Value Peripheral::Notify(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
   Napi::HandleScope scope(env);
@@ -601,13 +1187,189 @@ Napi::Value Peripheral::Notify(const Napi::CallbackInfo &info) {
   memcpy(characteristic.value, cbChar.Utf8Value().c_str(),
          SIMPLEBLE_UUID_STR_LEN);
 
-  const auto [it, _] = notifyFns.emplace(std::string(characteristic.value), Napi::ThreadSafeFunction::New(env, cbFn, "onNotify", 0, 1));
-  it->second.Unref(env);
+  Subscription::Options options;
+  if (info.Length() > 3 && info[3].IsObject() &&
+      !Subscription::ParseOptions(env, info[3].As<Napi::Object>(), options)) {
+    return env.Undefined();
+  }
+
+  if (!CheckMode(env, characteristic, false, Subscription::Mode::Plain)) {
+    return env.Undefined();
+  }
+
+  if (Join(characteristic, false, false, cbFn)) {
+    return Napi::Boolean::New(env, true);
+  }
 
-  const auto ret = simpleble_peripheral_notify(this->handle, service,
-                                               characteristic, onNotify, this);
+  auto subscription = Subscription::New(env, cbFn, "onNotify", options);
+  const auto ret = Subscribe(service, characteristic, false, subscription);
 
-  return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
+  return Napi::Boolean::New(env, ret);
+}
+
+Napi::Value Peripheral::NotifyBatched(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 3) {
+    Napi::TypeError::New(env, "Missing options").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[2].IsObject()) {
+    Napi::TypeError::New(env, "Options is not an object")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 4) {
+    Napi::TypeError::New(env, "Missing callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[3].IsFunction()) {
+    Napi::TypeError::New(env, "Callback is not a function")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Subscription::Options options;
+  if (!Subscription::ParseBatchOptions(env, info[2].As<Napi::Object>(),
+                                       options)) {
+    return env.Undefined();
+  }
+
+  if (!CheckMode(env, characteristic, false, Subscription::Mode::Batched)) {
+    return env.Undefined();
+  }
+
+  if (Join(characteristic, false, true, info[3].As<Napi::Function>())) {
+    return Napi::Boolean::New(env, true);
+  }
+
+  auto subscription = Subscription::New(env, info[3].As<Napi::Function>(),
+                                        "onNotifyBatched", options);
+  const auto ret = Subscribe(service, characteristic, false, subscription);
+
+  return Napi::Boolean::New(env, ret);
+}
+
+Napi::Value Peripheral::NotifyDecoded(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 3) {
+    Napi::TypeError::New(env, "Missing layout").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[2].IsObject()) {
+    Napi::TypeError::New(env, "Layout is not an object")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 4) {
+    Napi::TypeError::New(env, "Missing options").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[3].IsObject()) {
+    Napi::TypeError::New(env, "Options is not an object")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 5) {
+    Napi::TypeError::New(env, "Missing callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[4].IsFunction()) {
+    Napi::TypeError::New(env, "Callback is not a function")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  PayloadDecoder decoder;
+  if (!PayloadDecoder::Parse(env, info[2].As<Napi::Object>(), decoder)) {
+    return env.Undefined();
+  }
+
+  Subscription::Options options;
+  if (!Subscription::ParseBatchOptions(env, info[3].As<Napi::Object>(),
+                                       options)) {
+    return env.Undefined();
+  }
+
+  if (!CheckMode(env, characteristic, false, Subscription::Mode::Decoded)) {
+    return env.Undefined();
+  }
+
+  auto subscription =
+      Subscription::NewDecoded(env, info[4].As<Napi::Function>(),
+                               "onNotifyDecoded", options, std::move(decoder));
+  const auto ret = Subscribe(service, characteristic, false, subscription);
+
+  return Napi::Boolean::New(env, ret);
+}
+
+Napi::Value Peripheral::NotifyShared(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+
+  if (!GetUuidArg(info, 0, "service", service) ||
+      !GetUuidArg(info, 1, "characteristic", characteristic)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 3) {
+    Napi::TypeError::New(env, "Missing ring").ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (!info[2].IsTypedArray() ||
+             info[2].As<Napi::TypedArray>().TypedArrayType() !=
+                 napi_int32_array) {
+    Napi::TypeError::New(env, "Ring is not an Int32Array")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  const auto ring = info[2].As<Napi::Int32Array>();
+  if (ring.ByteOffset() % 8 != 0) {
+    Napi::RangeError::New(env, "Ring must start on an 8 byte boundary")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  } else if (SharedRing::DataSize(ring.ByteLength()) == 0) {
+    Napi::RangeError::New(env, "Ring is too small")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Subscription::Options options;
+  if (info.Length() > 3 && info[3].IsObject() &&
+      info[3].As<Napi::Object>().Get("wake").IsBoolean()) {
+    options.wake =
+        info[3].As<Napi::Object>().Get("wake").As<Napi::Boolean>().Value();
+  }
+
+  if (!CheckMode(env, characteristic, false, Subscription::Mode::Shared)) {
+    return env.Undefined();
+  }
+
+  auto subscription =
+      Subscription::NewShared(env, ring, "onNotifyShared", options);
+  const auto ret = Subscribe(service, characteristic, false, subscription);
+
+  return Napi::Boolean::New(env, ret);
 }
 
 Napi::Value Peripheral::Indicate(const Napi::CallbackInfo &info) {
@@ -652,13 +1414,56 @@ Napi::Value Peripheral::Indicate(const Napi::CallbackInfo &info) {
   memcpy(characteristic.value, cbChar.Utf8Value().c_str(),
          SIMPLEBLE_UUID_STR_LEN);
 
-  const auto [it, _] = indicateFns.emplace(std::string(characteristic.value), Napi::ThreadSafeFunction::New(env, cbFn, "onIndicate", 0, 1));
-    it->second.Unref(env);
+  Subscription::Options options;
+  if (info.Length() > 3 && info[3].IsObject() &&
+      !Subscription::ParseOptions(env, info[3].As<Napi::Object>(), options)) {
+    return env.Undefined();
+  }
 
-  const auto ret = simpleble_peripheral_indicate(
-      this->handle, service, characteristic, onIndicate, this);
+  if (!CheckMode(env, characteristic, true, Subscription::Mode::Plain)) {
+    return env.Undefined();
+  }
 
-  return Napi::Boolean::New(env, ret == SIMPLEBLE_SUCCESS);
+  if (Join(characteristic, true, false, cbFn)) {
+    return Napi::Boolean::New(env, true);
+  }
+
+  auto subscription = Subscription::New(env, cbFn, "onIndicate", options);
+  const auto ret = Subscribe(service, characteristic, true, subscription);
+
+  return Napi::Boolean::New(env, ret);
+}
+
+bool Peripheral::Subscribe(simpleble_uuid_t service,
+                           simpleble_uuid_t characteristic, bool indicate,
+                           Subscription *subscription) {
+  auto &subscriptions = indicate ? this->indications : this->notifications;
+  const std::string key(characteristic.value);
+  subscription->SetMetrics(GetMetrics());
+
+  if (const auto it = subscriptions.find(key); it != subscriptions.end()) {
+    it->second->Close();
+    subscriptions.erase(it);
+  }
+
+  const auto ret =
+      indicate ? simpleble_peripheral_indicate(this->handle, service,
+                                               characteristic, onIndicate,
+                                               subscription)
+               : simpleble_peripheral_notify(this->handle, service,
+                                             characteristic, onNotify,
+                                             subscription);
+
+  if (ret != SIMPLEBLE_SUCCESS) {
+    subscription->Close();
+    UpdateRetained();
+    return false;
+  }
+
+  subscriptions.emplace(key, subscription);
+  this->subscribedServices[key] = service;
+  UpdateRetained();
+  return true;
 }
 
 Napi::Value Peripheral::SetCallbackOnConnected(const Napi::CallbackInfo &info) {
@@ -674,6 +1479,11 @@ Napi::Value Peripheral::SetCallbackOnConnected(const Napi::CallbackInfo &info) {
     return Napi::Boolean::New(env, false);
   }
 
+  // Replacing the callback, the previous one is no longer called
+  if (this->onConnectedFn) {
+    this->onConnectedFn.Release();
+  }
+
   this->onConnectedFn = Napi::ThreadSafeFunction::New(
       env, info[0].As<Napi::Function>(), "onConnected", 0, 1);
   this->onConnectedFn.Unref(env);
@@ -698,6 +1508,10 @@ Peripheral::SetCallbackOnDisconnected(const Napi::CallbackInfo &info) {
     return Napi::Boolean::New(env, false);
   }
 
+  if (this->onDisconnectedFn) {
+    this->onDisconnectedFn.Release();
+  }
+
   this->onDisconnectedFn = Napi::ThreadSafeFunction::New(
       env, info[0].As<Napi::Function>(), "onDisconnectedFn", 0, 1);
   this->onDisconnectedFn.Unref(env);
@@ -710,6 +1524,7 @@ Peripheral::SetCallbackOnDisconnected(const Napi::CallbackInfo &info) {
 
 void Peripheral::onConnected(simpleble_peripheral_t, void *userdata) {
   auto peripheral = reinterpret_cast<Peripheral *>(userdata);
+  peripheral->servicesEpoch++;
   auto callback = [](Napi::Env env, Napi::Function jsCallback) {
     jsCallback.Call({});
   };
@@ -718,6 +1533,7 @@ void Peripheral::onConnected(simpleble_peripheral_t, void *userdata) {
 
 void Peripheral::onDisconnected(simpleble_peripheral_t, void *userdata) {
   auto peripheral = reinterpret_cast<Peripheral *>(userdata);
+  peripheral->servicesEpoch++;
   auto callback = [](Napi::Env env, Napi::Function jsCallback) {
     jsCallback.Call({});
   };
@@ -727,36 +1543,14 @@ void Peripheral::onDisconnected(simpleble_peripheral_t, void *userdata) {
 void Peripheral::onNotify(simpleble_uuid_t service,
                           simpleble_uuid_t characteristic, const uint8_t *data,
                           size_t data_length, void *userdata) {
-  auto peripheral = reinterpret_cast<Peripheral *>(userdata);
-  std::vector<uint8_t> vecData(data, data + data_length);
-  auto callback = [vecData](Napi::Env env, Napi::Function jsCallback) {
-    auto arrayBuffer = Napi::ArrayBuffer::New(env, vecData.size());
-    std::memcpy(arrayBuffer.Data(), vecData.data(), vecData.size());
-    auto uint8Array =
-        Napi::Uint8Array::New(env, vecData.size(), arrayBuffer, 0);
-    jsCallback.Call({uint8Array});
-  };
-
-  auto& notifyFns = peripheral->notifyFns;
-  if (const auto it = notifyFns.find(std::string(characteristic.value)); it != notifyFns.end())
-    it->second.NonBlockingCall(callback);
+  auto subscription = reinterpret_cast<Subscription *>(userdata);
+  subscription->Push(data, data_length);
 }
 
 void Peripheral::onIndicate(simpleble_uuid_t service,
                             simpleble_uuid_t characteristic,
                             const uint8_t *data, size_t data_length,
                             void *userdata) {
-  auto peripheral = reinterpret_cast<Peripheral *>(userdata);
-  std::vector<uint8_t> vecData(data, data + data_length);
-  auto callback = [vecData](Napi::Env env, Napi::Function jsCallback) {
-    auto arrayBuffer = Napi::ArrayBuffer::New(env, vecData.size());
-    std::memcpy(arrayBuffer.Data(), vecData.data(), vecData.size());
-    auto uint8Array =
-        Napi::Uint8Array::New(env, vecData.size(), arrayBuffer, 0);
-    jsCallback.Call({uint8Array});
-  };
-
-  auto& indicateFns = peripheral->indicateFns;
-  if (const auto it = indicateFns.find(std::string(characteristic.value)); it != indicateFns.end())
-    it->second.NonBlockingCall(callback);
+  auto subscription = reinterpret_cast<Subscription *>(userdata);
+  subscription->Push(data, data_length);
 }
@@ -1,25 +1,60 @@
 #pragma once
 
+#include "gatt_queue.h"
+#include "metrics.h"
+#include "subscription.h"
+#include <atomic>
 #include <map>
 #include <napi.h>
 #include <simpleble_c/peripheral.h>
+#include <vector>
 
 #define SIMPLEBLE_UUID_STR_LEN_TS (SIMPLEBLE_UUID_STR_LEN - 1) // remove null terminator
 
+// Argument helpers shared with the attribute bindings, both throw and return
+// false on invalid input
+bool GetUuidArg(const Napi::CallbackInfo &info, size_t index, const char *name,
+                simpleble_uuid_t &uuid);
+bool GetDataArg(const Napi::CallbackInfo &info, size_t index,
+                std::vector<uint8_t> &data);
+
 class Peripheral : public Napi::ObjectWrap<Peripheral> {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
   Peripheral(const Napi::CallbackInfo &info);
   ~Peripheral();
 
-  static Napi::FunctionReference constructor;
+  // Unsubscribes everything without touching JS, so SimpleBLE stops calling
+  // into this environment once it shuts down
+  void Shutdown();
 
 private:
+  friend class Attribute;
+
   simpleble_peripheral_t handle;
-  std::map<std::string, Napi::ThreadSafeFunction> notifyFns;
-  std::map<std::string, Napi::ThreadSafeFunction> indicateFns;
+  std::map<std::string, Subscription *> notifications;
+  std::map<std::string, Subscription *> indications;
+  // Service of each subscribed characteristic, for unsubscribing on teardown
+  std::map<std::string, simpleble_uuid_t> subscribedServices;
   Napi::ThreadSafeFunction onConnectedFn;
   Napi::ThreadSafeFunction onDisconnectedFn;
+  GattQueue queue;
+  // Set while anything is subscribed. The wrapper is then kept from
+  // collection, so the blocking CCCD writes of an unsubscribe never run in a
+  // finalizer.
+  bool retained = false;
+
+  // The services tree is built once per connection and handed back on every
+  // access. The epoch is bumped by anything that may change the tree, a cache
+  // built under an older epoch is rebuilt.
+  Napi::Reference<Napi::Array> servicesCache;
+  uint64_t servicesCacheEpoch = 0;
+  std::atomic<uint64_t> servicesEpoch{0};
+  uint64_t servicesCacheHits = 0;
+  uint64_t servicesCacheMisses = 0;
+
+  // Created on first use, most wrappers only ever carry a scan result
+  std::shared_ptr<Metrics> metrics;
 
   Napi::Value Identifier(const Napi::CallbackInfo &info);
   Napi::Value Address(const Napi::CallbackInfo &info);
@@ -28,24 +63,64 @@ private:
   Napi::Value TxPower(const Napi::CallbackInfo &info);
   Napi::Value MTU(const Napi::CallbackInfo &info);
   Napi::Value Connect(const Napi::CallbackInfo &info);
+  Napi::Value ConnectAsync(const Napi::CallbackInfo &info);
   Napi::Value Disconnect(const Napi::CallbackInfo &info);
+  Napi::Value DisconnectAsync(const Napi::CallbackInfo &info);
   Napi::Value Connected(const Napi::CallbackInfo &info);
   Napi::Value Connectable(const Napi::CallbackInfo &info);
   Napi::Value Paired(const Napi::CallbackInfo &info);
   Napi::Value Unpair(const Napi::CallbackInfo &info);
   Napi::Value GetServices(const Napi::CallbackInfo &info);
+  Napi::Value InvalidateServices(const Napi::CallbackInfo &info);
+  Napi::Value ServicesCacheStats(const Napi::CallbackInfo &info);
   Napi::Value GetManufacturerData(const Napi::CallbackInfo &info);
   Napi::Value Read(const Napi::CallbackInfo &info);
+  Napi::Value ReadAsync(const Napi::CallbackInfo &info);
+  Napi::Value ReadMany(const Napi::CallbackInfo &info);
   Napi::Value WriteRequest(const Napi::CallbackInfo &info);
+  Napi::Value WriteRequestAsync(const Napi::CallbackInfo &info);
   Napi::Value WriteCommand(const Napi::CallbackInfo &info);
+  Napi::Value WriteCommandAsync(const Napi::CallbackInfo &info);
+  Napi::Value WriteMany(const Napi::CallbackInfo &info);
+  Napi::Value WriteStream(const Napi::CallbackInfo &info);
   Napi::Value Notify(const Napi::CallbackInfo &info);
+  Napi::Value NotifyBatched(const Napi::CallbackInfo &info);
+  Napi::Value NotifyDecoded(const Napi::CallbackInfo &info);
+  Napi::Value NotifyShared(const Napi::CallbackInfo &info);
   Napi::Value Indicate(const Napi::CallbackInfo &info);
   Napi::Value Unsubscribe(const Napi::CallbackInfo &info);
+  Napi::Value GetAttribute(const Napi::CallbackInfo &info);
+  Napi::Value SubscriptionStats(const Napi::CallbackInfo &info);
   Napi::Value ReadDescriptor(const Napi::CallbackInfo &info);
+  Napi::Value ReadDescriptorAsync(const Napi::CallbackInfo &info);
   Napi::Value WriteDescriptor(const Napi::CallbackInfo &info);
+  Napi::Value WriteDescriptorAsync(const Napi::CallbackInfo &info);
   Napi::Value SetCallbackOnConnected(const Napi::CallbackInfo &info);
   Napi::Value SetCallbackOnDisconnected(const Napi::CallbackInfo &info);
 
+  const std::shared_ptr<Metrics> &GetMetrics();
+  // The GATT queue, reporting to this peripheral's metrics
+  GattQueue &Queue();
+  Napi::Array BuildServices(Napi::Env env);
+  // Holds or lets go of the wrapper as the first subscription starts or the
+  // last one ends
+  void UpdateRetained();
+  bool Subscribe(simpleble_uuid_t service, simpleble_uuid_t characteristic,
+                 bool indicate, Subscription *subscription);
+  // Throws a TypeError and returns false if the characteristic is already
+  // subscribed in another mode, which a new subscription would replace along
+  // with its subscribers.
+  bool CheckMode(Napi::Env env, simpleble_uuid_t characteristic, bool indicate,
+                 Subscription::Mode mode);
+  // Adds the callback as a subscriber of a live subscription of the same
+  // kind, returning false if there is none to share.
+  bool Join(simpleble_uuid_t characteristic, bool indicate, bool batched,
+            Napi::Function callback);
+  // Removes one subscriber, or every one if the callback is empty. The
+  // subscription and its CCCD are only torn down with the last.
+  bool Unsubscribe(simpleble_uuid_t service, simpleble_uuid_t characteristic,
+                   Napi::Function callback = Napi::Function());
+
   static void onConnected(simpleble_peripheral_t peripheral, void *userdata);
   static void onDisconnected(simpleble_peripheral_t peripheral, void *userdata);
   static void onNotify(simpleble_uuid_t service, simpleble_uuid_t characteristic, const uint8_t* data, size_t data_length, void* userdata);
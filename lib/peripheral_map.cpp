@@ -0,0 +1,48 @@
+#include "peripheral_map.h"
+#include "addon.h"
+#include "simpleble_c/simpleble.h"
+
+#include <algorithm>
+
+Napi::Value PeripheralMap::Get(Napi::Env env, simpleble_peripheral_t handle) {
+  char *value = simpleble_peripheral_address(handle);
+  const std::string address(value != nullptr ? value : "");
+  simpleble_free(value);
+
+  if (!address.empty()) {
+    const auto it = this->wrappers.find(address);
+    if (it != this->wrappers.end()) {
+      Napi::Object wrapper = it->second.Value();
+      if (!wrapper.IsEmpty()) {
+        simpleble_peripheral_release_handle(handle);
+        return wrapper;
+      }
+      this->wrappers.erase(it);
+    }
+  }
+
+  Napi::Object wrapper = AddonData::Get(env)->peripheralConstructor.New(
+      {Napi::BigInt::New(env, reinterpret_cast<uint64_t>(handle))});
+  if (address.empty() || env.IsExceptionPending()) {
+    return wrapper;
+  }
+
+  if (this->wrappers.size() >= this->sweepAt) {
+    Sweep();
+  }
+  this->wrappers.emplace(address, Napi::Weak(wrapper));
+  return wrapper;
+}
+
+void PeripheralMap::Sweep() {
+  for (auto it = this->wrappers.begin(); it != this->wrappers.end();) {
+    if (it->second.Value().IsEmpty()) {
+      it = this->wrappers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Sweep again once the live entries have doubled
+  this->sweepAt = std::max<size_t>(64, this->wrappers.size() * 2);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <napi.h>
+#include <simpleble_c/peripheral.h>
+#include <string>
+#include <unordered_map>
+
+// Peripheral wrappers handed to JS by one adapter, keyed by address so a
+// device seen again returns the same object instead of a new wrapper and
+// handle. Entries are weak, a wrapper JS no longer holds is collected as usual
+// and its entry swept once the map grows. Only used on the JS thread.
+class PeripheralMap {
+public:
+  // Returns the wrapper for a peripheral, taking ownership of the handle.
+  Napi::Value Get(Napi::Env env, simpleble_peripheral_t handle);
+
+private:
+  void Sweep();
+
+  std::unordered_map<std::string, Napi::ObjectReference> wrappers;
+  size_t sweepAt = 64;
+};
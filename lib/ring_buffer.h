@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// What to do when a producer finds the ring full.
+enum class Overflow {
+  DropOldest, // evict the oldest queued item to make room
+  DropNewest, // discard the item being pushed
+  Block,      // wait for the consumer, stalling the producer thread for at
+              // most the block timeout before dropping the item being pushed
+};
+
+// Bounded lock-free ring of owned pointers between one producer thread and
+// one consumer thread. Items that are dropped or left behind are passed to
+// the deleter. Evicting under DropOldest races the consumer for the tail
+// with a compare-and-swap, so an item is only ever taken once.
+template <typename T> class RingBuffer {
+public:
+  using Deleter = void (*)(T *);
+
+  RingBuffer(size_t capacity, Overflow overflow, Deleter deleter,
+             std::chrono::milliseconds blockTimeout =
+                 std::chrono::milliseconds(100))
+      : overflow(overflow), deleter(deleter), blockTimeout(blockTimeout) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    this->mask = size - 1;
+    this->slots.reset(new std::atomic<T *>[size]);
+  }
+
+  ~RingBuffer() {
+    while (T *item = Pop()) {
+      this->deleter(item);
+    }
+  }
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  // Producer side. Returns false if an item was dropped to satisfy the
+  // overflow policy. Under Block the calling thread, for SimpleBLE the thread
+  // delivering every callback of the adapter, waits until the consumer makes
+  // room, the ring is closed or the block timeout passes.
+  bool Push(T *item) {
+    bool dropped = false;
+    std::chrono::steady_clock::time_point deadline;
+
+    while (true) {
+      const size_t head = this->head.load(std::memory_order_relaxed);
+      size_t tail = this->tail.load(std::memory_order_acquire);
+
+      if (head - tail <= this->mask) {
+        this->slots[head & this->mask].store(item, std::memory_order_relaxed);
+        this->head.store(head + 1, std::memory_order_release);
+        return !dropped;
+      }
+
+      bool expired = false;
+      if (this->overflow == Overflow::Block) {
+        const auto now = std::chrono::steady_clock::now();
+        if (deadline == std::chrono::steady_clock::time_point()) {
+          deadline = now + this->blockTimeout;
+        }
+        expired = now >= deadline;
+      }
+
+      if (this->closed.load(std::memory_order_relaxed) ||
+          this->overflow == Overflow::DropNewest || expired) {
+        this->deleter(item);
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      if (this->overflow == Overflow::Block) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+
+      T *oldest = this->slots[tail & this->mask].load(std::memory_order_relaxed);
+      if (this->tail.compare_exchange_strong(tail, tail + 1,
+                                             std::memory_order_acq_rel)) {
+        this->deleter(oldest);
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        dropped = true;
+      }
+    }
+  }
+
+  // Consumer side. Returns nullptr when empty.
+  T *Pop() {
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+
+    while (tail != this->head.load(std::memory_order_acquire)) {
+      T *item = this->slots[tail & this->mask].load(std::memory_order_relaxed);
+      if (this->tail.compare_exchange_weak(tail, tail + 1,
+                                           std::memory_order_acq_rel)) {
+        return item;
+      }
+    }
+
+    return nullptr;
+  }
+
+  size_t Size() const {
+    // Tail first, head can only have moved further on since
+    const size_t tail = this->tail.load(std::memory_order_acquire);
+    return this->head.load(std::memory_order_acquire) - tail;
+  }
+
+  size_t Capacity() const { return this->mask + 1; }
+
+  uint64_t Dropped() const {
+    return this->dropped.load(std::memory_order_relaxed);
+  }
+
+  // Releases a producer blocked on a full ring, later overflows drop.
+  void Close() { this->closed.store(true, std::memory_order_relaxed); }
+
+private:
+  Overflow overflow;
+  Deleter deleter;
+  std::chrono::milliseconds blockTimeout;
+  size_t mask;
+  std::unique_ptr<std::atomic<T *>[]> slots;
+  std::atomic<bool> closed{false};
+  std::atomic<uint64_t> dropped{0};
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,202 @@
+#include "scan_filter.h"
+#include "simpleble_c/simpleble.h"
+
+#include <algorithm>
+#include <cctype>
+
+static std::string ToLower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return value;
+}
+
+// Expands 16 and 32 bit UUIDs onto the Bluetooth base UUID, matching
+// BluetoothUUID.canonicalUUID
+static std::string CanonicalUuid(const std::string &uuid) {
+  const std::string value = ToLower(uuid);
+  if (value.size() == 4) {
+    return "0000" + value + "-0000-1000-8000-00805f9b34fb";
+  } else if (value.size() == 8) {
+    return value + "-0000-1000-8000-00805f9b34fb";
+  }
+  return value;
+}
+
+static bool GetStrings(Napi::Env env, Napi::Object obj, const char *name,
+                       std::vector<std::string> &values, bool lower = true) {
+  const Napi::Value value = obj.Get(name);
+  if (value.IsUndefined()) {
+    return true;
+  } else if (!value.IsArray()) {
+    Napi::TypeError::New(env, std::string(name) + " is not an array")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  const Napi::Array array = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    const Napi::Value item = array.Get(i);
+    if (!item.IsString()) {
+      Napi::TypeError::New(env, std::string(name) + " must contain strings")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    const std::string str = item.As<Napi::String>().Utf8Value();
+    values.push_back(lower ? ToLower(str) : str);
+  }
+
+  return true;
+}
+
+bool ScanFilter::Parse(Napi::Env env, Napi::Object obj, Criteria &criteria) {
+  // UUIDs and addresses compare case-insensitively, name prefixes as given
+  if (!GetStrings(env, obj, "services", criteria.services) ||
+      !GetStrings(env, obj, "namePrefixes", criteria.namePrefixes, false) ||
+      !GetStrings(env, obj, "addresses", criteria.addresses)) {
+    return false;
+  }
+
+  for (auto &uuid : criteria.services) {
+    uuid = CanonicalUuid(uuid);
+  }
+
+  const Napi::Value manufacturerIds = obj.Get("manufacturerIds");
+  if (manufacturerIds.IsArray()) {
+    const Napi::Array array = manufacturerIds.As<Napi::Array>();
+    for (uint32_t i = 0; i < array.Length(); i++) {
+      const Napi::Value item = array.Get(i);
+      if (!item.IsNumber()) {
+        Napi::TypeError::New(env, "manufacturerIds must contain numbers")
+            .ThrowAsJavaScriptException();
+        return false;
+      }
+      criteria.manufacturerIds.push_back(
+          uint16_t(item.As<Napi::Number>().Uint32Value()));
+    }
+  } else if (!manufacturerIds.IsUndefined()) {
+    Napi::TypeError::New(env, "manufacturerIds is not an array")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  const Napi::Value rssi = obj.Get("rssi");
+  if (rssi.IsNumber()) {
+    criteria.hasRssi = true;
+    criteria.rssi = int16_t(rssi.As<Napi::Number>().Int32Value());
+  }
+
+  criteria.dedupe = obj.Get("dedupe").ToBoolean();
+  return true;
+}
+
+void ScanFilter::Set(const Criteria &criteria) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->criteria = criteria;
+  this->active = criteria.dedupe || criteria.hasRssi ||
+                 !criteria.services.empty() ||
+                 !criteria.namePrefixes.empty() ||
+                 !criteria.manufacturerIds.empty() ||
+                 !criteria.addresses.empty();
+  this->reportedFound.clear();
+  this->reportedUpdated.clear();
+}
+
+void ScanFilter::Reset() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->reportedFound.clear();
+  this->reportedUpdated.clear();
+}
+
+bool ScanFilter::Accept(simpleble_peripheral_t peripheral, bool found) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->active) {
+    return true;
+  }
+
+  std::string address;
+  if (this->criteria.dedupe || !this->criteria.addresses.empty()) {
+    char *value = simpleble_peripheral_address(peripheral);
+    address = ToLower(value != nullptr ? value : "");
+    simpleble_free(value);
+  }
+
+  if (!Matches(peripheral, address)) {
+    return false;
+  }
+
+  if (this->criteria.dedupe) {
+    auto &reported = found ? this->reportedFound : this->reportedUpdated;
+    return reported.insert(address).second;
+  }
+
+  return true;
+}
+
+bool ScanFilter::Matches(simpleble_peripheral_t peripheral,
+                         const std::string &address) {
+  const Criteria &criteria = this->criteria;
+
+  if (criteria.hasRssi &&
+      simpleble_peripheral_rssi(peripheral) < criteria.rssi) {
+    return false;
+  }
+
+  if (!criteria.addresses.empty() &&
+      std::find(criteria.addresses.begin(), criteria.addresses.end(),
+                address) == criteria.addresses.end()) {
+    return false;
+  }
+
+  if (!criteria.namePrefixes.empty()) {
+    char *value = simpleble_peripheral_identifier(peripheral);
+    const std::string name(value != nullptr ? value : "");
+    simpleble_free(value);
+
+    const bool matched = std::any_of(
+        criteria.namePrefixes.begin(), criteria.namePrefixes.end(),
+        [&name](const std::string &prefix) {
+          return name.compare(0, prefix.size(), prefix) == 0;
+        });
+    if (!matched) {
+      return false;
+    }
+  }
+
+  if (!criteria.manufacturerIds.empty()) {
+    bool matched = false;
+    const size_t count =
+        simpleble_peripheral_manufacturer_data_count(peripheral);
+    for (size_t i = 0; i < count && !matched; i++) {
+      simpleble_manufacturer_data_t data;
+      if (simpleble_peripheral_manufacturer_data_get(peripheral, i, &data) ==
+          SIMPLEBLE_SUCCESS) {
+        matched = std::find(criteria.manufacturerIds.begin(),
+                            criteria.manufacturerIds.end(),
+                            data.manufacturer_id) !=
+                  criteria.manufacturerIds.end();
+      }
+    }
+    if (!matched) {
+      return false;
+    }
+  }
+
+  if (!criteria.services.empty()) {
+    bool matched = false;
+    const size_t count = simpleble_peripheral_services_count(peripheral);
+    for (size_t i = 0; i < count && !matched; i++) {
+      simpleble_service_t service;
+      if (simpleble_peripheral_services_get(peripheral, i, &service) ==
+          SIMPLEBLE_SUCCESS) {
+        const std::string uuid = CanonicalUuid(service.uuid.value);
+        matched = std::find(criteria.services.begin(), criteria.services.end(),
+                            uuid) != criteria.services.end();
+      }
+    }
+    if (!matched) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <napi.h>
+#include <simpleble_c/peripheral.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Scan filter evaluated on the SimpleBLE thread, so peripherals that can't
+// match never cross into JS. Every criterion that is set must match, within a
+// criterion any of the listed values may match. With dedupe set, each address
+// is reported at most once per scan on each callback.
+class ScanFilter {
+public:
+  struct Criteria {
+    std::vector<std::string> services;
+    std::vector<std::string> namePrefixes;
+    std::vector<uint16_t> manufacturerIds;
+    std::vector<std::string> addresses;
+    bool hasRssi = false;
+    int16_t rssi = 0;
+    bool dedupe = false;
+  };
+
+  // Throws and returns false on an invalid filter object.
+  static bool Parse(Napi::Env env, Napi::Object obj, Criteria &criteria);
+
+  void Set(const Criteria &criteria);
+
+  // Forgets reported addresses, called when a scan starts.
+  void Reset();
+
+  // Called from the SimpleBLE thread.
+  bool Accept(simpleble_peripheral_t peripheral, bool found);
+
+private:
+  bool Matches(simpleble_peripheral_t peripheral, const std::string &address);
+
+  std::mutex mutex;
+  Criteria criteria;
+  bool active = false;
+  std::unordered_set<std::string> reportedFound;
+  std::unordered_set<std::string> reportedUpdated;
+};
@@ -0,0 +1,127 @@
+#include "scan_records.h"
+#include "buffer.h"
+#include "peripheral.h"
+#include "simpleble_c/simpleble.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+static void Put8(std::vector<uint8_t> &out, size_t offset, uint8_t value) {
+  out[offset] = value;
+}
+
+static void Put16(std::vector<uint8_t> &out, size_t offset, uint16_t value) {
+  out[offset] = uint8_t(value);
+  out[offset + 1] = uint8_t(value >> 8);
+}
+
+static void Put32(std::vector<uint8_t> &out, size_t offset, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    out[offset + i] = uint8_t(value >> (8 * i));
+  }
+}
+
+static void Append(std::vector<uint8_t> &out, const void *data,
+                   size_t length) {
+  const auto bytes = reinterpret_cast<const uint8_t *>(data);
+  out.insert(out.end(), bytes, bytes + length);
+}
+
+// Appends a string returned by SimpleBLE and frees it, returning its length
+static uint16_t AppendString(std::vector<uint8_t> &out, char *value) {
+  size_t length = 0;
+  if (value != nullptr) {
+    length = std::min<size_t>(std::strlen(value), UINT16_MAX);
+    Append(out, value, length);
+    simpleble_free(value);
+  }
+  return uint16_t(length);
+}
+
+Napi::ArrayBuffer PackScanResults(Napi::Env env, simpleble_adapter_t adapter) {
+  const size_t count = simpleble_adapter_scan_get_results_count(adapter);
+
+  // Records are written in place, payloads appended after them
+  std::vector<uint8_t> out(SCAN_RECORDS_HEADER_SIZE +
+                           count * SCAN_RECORDS_RECORD_SIZE);
+  // Adverts are small, reserve enough for a typical one per record
+  out.reserve(out.size() + count * 64);
+
+  size_t packed = 0;
+  for (size_t i = 0; i < count; i++) {
+    simpleble_peripheral_t peripheral =
+        simpleble_adapter_scan_get_results_handle(adapter, i);
+    if (peripheral == nullptr) {
+      continue;
+    }
+
+    const size_t record =
+        SCAN_RECORDS_HEADER_SIZE + packed * SCAN_RECORDS_RECORD_SIZE;
+    const size_t start = out.size();
+
+    bool connectable = false;
+    bool paired = false;
+    simpleble_peripheral_is_connectable(peripheral, &connectable);
+    simpleble_peripheral_is_paired(peripheral, &paired);
+
+    Put16(out, record, uint16_t(simpleble_peripheral_rssi(peripheral)));
+    Put16(out, record + 2, uint16_t(simpleble_peripheral_tx_power(peripheral)));
+    Put8(out, record + 4, uint8_t(simpleble_peripheral_address_type(peripheral)));
+    Put8(out, record + 5, (connectable ? 1 : 0) | (paired ? 2 : 0));
+    Put16(out, record + 12,
+          AppendString(out, simpleble_peripheral_identifier(peripheral)));
+    Put16(out, record + 14,
+          AppendString(out, simpleble_peripheral_address(peripheral)));
+
+    uint8_t services = 0;
+    const size_t serviceCount = simpleble_peripheral_services_count(peripheral);
+    for (size_t j = 0; j < serviceCount && services < UINT8_MAX; j++) {
+      simpleble_service_t service;
+      if (simpleble_peripheral_services_get(peripheral, j, &service) !=
+          SIMPLEBLE_SUCCESS) {
+        continue;
+      }
+      const uint8_t length = uint8_t(service.data_length);
+      Append(out, service.uuid.value, SIMPLEBLE_UUID_STR_LEN_TS);
+      out.push_back(length);
+      Append(out, service.data, length);
+      services++;
+    }
+
+    uint8_t manufacturers = 0;
+    const size_t manufacturerCount =
+        simpleble_peripheral_manufacturer_data_count(peripheral);
+    for (size_t j = 0; j < manufacturerCount && manufacturers < UINT8_MAX;
+         j++) {
+      simpleble_manufacturer_data_t data;
+      if (simpleble_peripheral_manufacturer_data_get(peripheral, j, &data) !=
+          SIMPLEBLE_SUCCESS) {
+        continue;
+      }
+      const uint8_t length = uint8_t(data.data_length);
+      out.push_back(uint8_t(data.manufacturer_id));
+      out.push_back(uint8_t(data.manufacturer_id >> 8));
+      out.push_back(length);
+      Append(out, data.data, length);
+      manufacturers++;
+    }
+
+    simpleble_peripheral_release_handle(peripheral);
+
+    Put8(out, record + 6, services);
+    Put8(out, record + 7, manufacturers);
+    Put32(out, record + 8, uint32_t(start));
+    Put32(out, record + 16, uint32_t(out.size() - start));
+    packed++;
+  }
+
+  // Handles SimpleBLE failed to return leave unused slots at the end of the
+  // record table, the count covers only those written
+  Put32(out, 0, SCAN_RECORDS_VERSION);
+  Put32(out, 4, uint32_t(packed));
+
+  // Handed over rather than copied, small batches are still copied
+  return AdoptBuffer(env, std::move(out)).ArrayBuffer();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <napi.h>
+#include <simpleble_c/adapter.h>
+
+// Packs the adapter's current scan results into a single ArrayBuffer, so a
+// scan of any size costs one native call and one JS allocation. All values are
+// little endian.
+//
+//   header   u32 version, u32 record count
+//   records  fixed 20 bytes each, directly after the header:
+//            0  i16 rssi
+//            2  i16 tx power
+//            4  u8  address type
+//            5  u8  flags, bit 0 connectable, bit 1 paired
+//            6  u8  service count
+//            7  u8  manufacturer data count
+//            8  u32 offset of the record's payload from the buffer start
+//            12 u16 identifier length
+//            14 u16 address length
+//            16 u32 payload length
+//   payloads identifier and address as UTF-8, then each service as a 36 byte
+//            UUID, u8 data length and data, then each manufacturer data entry
+//            as u16 id, u8 data length and data
+//
+// The version is bumped whenever the layout changes.
+constexpr uint32_t SCAN_RECORDS_VERSION = 1;
+constexpr size_t SCAN_RECORDS_HEADER_SIZE = 8;
+constexpr size_t SCAN_RECORDS_RECORD_SIZE = 20;
+
+Napi::ArrayBuffer PackScanResults(Napi::Env env, simpleble_adapter_t adapter);
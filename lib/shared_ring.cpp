@@ -0,0 +1,78 @@
+#include "shared_ring.h"
+
+#include <cstring>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "Shared ring indices must be plain lock-free words");
+
+static constexpr size_t HEAD = 0;
+static constexpr size_t TAIL = 1;
+static constexpr size_t DROPPED = 2;
+static constexpr size_t VERSION = 3;
+
+static size_t Align(size_t length) { return (length + 7) & ~size_t(7); }
+
+size_t SharedRing::DataSize(size_t byteLength) {
+  if (byteLength < SHARED_RING_HEADER_SIZE + 64) {
+    return 0;
+  }
+
+  // Largest power of two that fits, at most 2^31 so indices wrap cleanly
+  size_t size = 64;
+  while (size < (size_t(1) << 31) &&
+         size * 2 <= byteLength - SHARED_RING_HEADER_SIZE) {
+    size *= 2;
+  }
+  return size;
+}
+
+SharedRing::SharedRing(uint8_t *memory, size_t byteLength)
+    : memory(memory), data(memory + SHARED_RING_HEADER_SIZE),
+      mask(uint32_t(DataSize(byteLength) - 1)) {
+  Slot(VERSION).store(SHARED_RING_VERSION, std::memory_order_relaxed);
+}
+
+bool SharedRing::Write(const uint8_t *data, size_t length, double timestamp) {
+  const size_t size = Align(SHARED_RING_RECORD_HEADER_SIZE + length);
+  const uint32_t head = Slot(HEAD).load(std::memory_order_relaxed);
+  const uint32_t tail = Slot(TAIL).load(std::memory_order_acquire);
+  const uint32_t position = head & this->mask;
+  const size_t contiguous = Capacity() - position;
+
+  // A record that doesn't fit before the end skips the rest of the data
+  const size_t skip = contiguous < size ? contiguous : 0;
+  if (size + skip > Capacity() - uint32_t(head - tail)) {
+    Slot(DROPPED).fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  uint8_t *record = this->data + position;
+  if (skip > 0) {
+    const uint32_t wrap = SHARED_RING_WRAP;
+    std::memcpy(record, &wrap, sizeof(wrap));
+    record = this->data;
+  }
+
+  const uint32_t payloadLength = uint32_t(length);
+  const uint32_t reserved = 0;
+  std::memcpy(record, &payloadLength, sizeof(payloadLength));
+  std::memcpy(record + 4, &reserved, sizeof(reserved));
+  std::memcpy(record + 8, &timestamp, sizeof(timestamp));
+  if (length > 0) {
+    std::memcpy(record + SHARED_RING_RECORD_HEADER_SIZE, data, length);
+  }
+
+  // Publishes the record, the consumer reads head before the data
+  Slot(HEAD).store(head + uint32_t(skip + size), std::memory_order_release);
+  return true;
+}
+
+uint32_t SharedRing::Dropped() const {
+  return Slot(DROPPED).load(std::memory_order_relaxed);
+}
+
+uint32_t SharedRing::Used() const {
+  return Slot(HEAD).load(std::memory_order_relaxed) -
+         Slot(TAIL).load(std::memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A ring of notification records in memory supplied by JS, normally a
+// SharedArrayBuffer viewed as an Int32Array, so worker threads can consume a
+// stream without it passing through the main thread. One producer, the
+// SimpleBLE thread of a single subscription, and one consumer. All values are
+// little endian, indices are read and written with Atomics.
+//
+//   header   64 bytes
+//            0  u32 head, bytes ever written, stored after the record
+//            4  u32 tail, bytes ever consumed, stored by the consumer
+//            8  u32 records dropped because the ring was full
+//            12 u32 version
+//   data     the rest of the buffer, a power of two of at least 64 bytes,
+//            position is head or tail modulo its size
+//   records  u32 payload length, u32 reserved, f64 time of receipt in
+//            milliseconds since the epoch, then the payload, padded to 8
+//            bytes. Records never wrap, a length of 0xffffffff marks the end
+//            of the data and the next record starts at position 0.
+//
+// The version is bumped whenever the layout changes.
+constexpr uint32_t SHARED_RING_VERSION = 1;
+constexpr size_t SHARED_RING_HEADER_SIZE = 64;
+constexpr size_t SHARED_RING_RECORD_HEADER_SIZE = 16;
+constexpr uint32_t SHARED_RING_WRAP = 0xffffffff;
+
+class SharedRing {
+public:
+  // Returns the size of the data area for a buffer, 0 if it can't hold a ring.
+  static size_t DataSize(size_t byteLength);
+
+  // The memory must stay valid for the life of the ring and be 8 byte aligned.
+  SharedRing(uint8_t *memory, size_t byteLength);
+
+  // Copies a record in, returning false and counting a drop if it doesn't fit.
+  bool Write(const uint8_t *data, size_t length, double timestamp);
+
+  uint32_t Dropped() const;
+  uint32_t Used() const;
+  size_t Capacity() const { return this->mask + 1; }
+
+private:
+  std::atomic<uint32_t> &Slot(size_t index) const {
+    return reinterpret_cast<std::atomic<uint32_t> *>(this->memory)[index];
+  }
+
+  uint8_t *memory;
+  uint8_t *data;
+  uint32_t mask;
+};
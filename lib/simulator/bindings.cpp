@@ -0,0 +1,276 @@
+#include "bindings.h"
+#include "simulator.h"
+
+#include <cctype>
+#include <cstdio>
+#include <string>
+
+namespace simulator {
+
+static bool GetUint32(Napi::Env env, Napi::Object obj, const char *name,
+                      uint32_t &value) {
+  const Napi::Value item = obj.Get(name);
+  if (item.IsUndefined()) {
+    return true;
+  } else if (!item.IsNumber()) {
+    Napi::TypeError::New(env, std::string(name) + " is not a number")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  value = item.As<Napi::Number>().Uint32Value();
+  return true;
+}
+
+static bool GetInt16(Napi::Env env, Napi::Object obj, const char *name,
+                     int16_t &value) {
+  const Napi::Value item = obj.Get(name);
+  if (item.IsUndefined()) {
+    return true;
+  } else if (!item.IsNumber()) {
+    Napi::TypeError::New(env, std::string(name) + " is not a number")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  value = int16_t(item.As<Napi::Number>().Int32Value());
+  return true;
+}
+
+static bool GetBool(Napi::Object obj, const char *name, bool &value) {
+  const Napi::Value item = obj.Get(name);
+  if (!item.IsUndefined()) {
+    value = item.ToBoolean();
+  }
+  return true;
+}
+
+static bool GetString(Napi::Env env, Napi::Object obj, const char *name,
+                      std::string &value) {
+  const Napi::Value item = obj.Get(name);
+  if (item.IsUndefined()) {
+    return true;
+  } else if (!item.IsString()) {
+    Napi::TypeError::New(env, std::string(name) + " is not a string")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  value = item.As<Napi::String>().Utf8Value();
+  return true;
+}
+
+static bool GetData(Napi::Env env, Napi::Object obj, const char *name,
+                    std::vector<uint8_t> &value) {
+  const Napi::Value item = obj.Get(name);
+  if (item.IsUndefined()) {
+    return true;
+  } else if (!item.IsTypedArray()) {
+    Napi::TypeError::New(env, std::string(name) + " is not a Uint8Array")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  const auto array = item.As<Napi::Uint8Array>();
+  value.assign(array.Data(), array.Data() + array.ByteLength());
+  return true;
+}
+
+// Calls parse for each object in the named array
+template <typename T, typename F>
+static bool GetList(Napi::Env env, Napi::Object obj, const char *name,
+                    std::vector<T> &values, F parse) {
+  const Napi::Value item = obj.Get(name);
+  if (item.IsUndefined()) {
+    return true;
+  } else if (!item.IsArray()) {
+    Napi::TypeError::New(env, std::string(name) + " is not an array")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  const Napi::Array array = item.As<Napi::Array>();
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    const Napi::Value element = array.Get(i);
+    if (!element.IsObject()) {
+      Napi::TypeError::New(env, std::string(name) + " must contain objects")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    T value;
+    if (!parse(element.As<Napi::Object>(), value)) {
+      return false;
+    }
+    values.push_back(std::move(value));
+  }
+  return true;
+}
+
+static bool ParseDescriptor(Napi::Env env, Napi::Object obj,
+                            Descriptor &descriptor) {
+  return GetString(env, obj, "uuid", descriptor.uuid) &&
+         GetData(env, obj, "value", descriptor.value);
+}
+
+static bool ParseCharacteristic(Napi::Env env, Napi::Object obj,
+                                Characteristic &characteristic) {
+  uint32_t notifyLength = uint32_t(characteristic.notifyLength);
+  if (!GetString(env, obj, "uuid", characteristic.uuid) ||
+      !GetBool(obj, "canRead", characteristic.canRead) ||
+      !GetBool(obj, "canWriteRequest", characteristic.canWriteRequest) ||
+      !GetBool(obj, "canWriteCommand", characteristic.canWriteCommand) ||
+      !GetBool(obj, "canNotify", characteristic.canNotify) ||
+      !GetBool(obj, "canIndicate", characteristic.canIndicate) ||
+      !GetData(env, obj, "value", characteristic.value) ||
+      !GetUint32(env, obj, "notifyInterval", characteristic.notifyInterval) ||
+      !GetUint32(env, obj, "notifyLength", notifyLength)) {
+    return false;
+  }
+  characteristic.notifyLength = notifyLength;
+
+  return GetList(env, obj, "descriptors", characteristic.descriptors,
+                 [env](Napi::Object item, Descriptor &descriptor) {
+                   return ParseDescriptor(env, item, descriptor);
+                 });
+}
+
+static bool ParseService(Napi::Env env, Napi::Object obj, Service &service) {
+  return GetString(env, obj, "uuid", service.uuid) &&
+         GetData(env, obj, "data", service.data) &&
+         GetList(env, obj, "characteristics", service.characteristics,
+                 [env](Napi::Object item, Characteristic &characteristic) {
+                   return ParseCharacteristic(env, item, characteristic);
+                 });
+}
+
+static bool ParsePeripheral(Napi::Env env, Napi::Object obj,
+                            Peripheral &peripheral) {
+  uint32_t addressType = peripheral.addressType;
+  uint32_t mtu = peripheral.mtu;
+  if (!GetString(env, obj, "identifier", peripheral.identifier) ||
+      !GetString(env, obj, "address", peripheral.address) ||
+      !GetUint32(env, obj, "addressType", addressType) ||
+      !GetInt16(env, obj, "rssi", peripheral.rssi) ||
+      !GetInt16(env, obj, "txPower", peripheral.txPower) ||
+      !GetUint32(env, obj, "mtu", mtu) ||
+      !GetBool(obj, "connectable", peripheral.connectable) ||
+      !GetBool(obj, "paired", peripheral.paired) ||
+      !GetUint32(env, obj, "advertisingInterval",
+                 peripheral.advertisingInterval) ||
+      !GetUint32(env, obj, "connectLatency", peripheral.connectLatency) ||
+      !GetUint32(env, obj, "readLatency", peripheral.readLatency) ||
+      !GetUint32(env, obj, "writeLatency", peripheral.writeLatency) ||
+      !GetUint32(env, obj, "disconnectAfter", peripheral.disconnectAfter) ||
+      !GetUint32(env, obj, "connectFailures", peripheral.connectFailures)) {
+    return false;
+  }
+  peripheral.addressType = simpleble_address_type_t(addressType);
+  peripheral.mtu = uint16_t(mtu);
+
+  struct ManufacturerData {
+    uint32_t id = 0;
+    std::vector<uint8_t> data;
+  };
+  std::vector<ManufacturerData> manufacturerData;
+  if (!GetList(env, obj, "manufacturerData", manufacturerData,
+               [env](Napi::Object item, ManufacturerData &value) {
+                 return GetUint32(env, item, "id", value.id) &&
+                        GetData(env, item, "data", value.data);
+               })) {
+    return false;
+  }
+  for (auto &item : manufacturerData) {
+    peripheral.manufacturerData[uint16_t(item.id)] = std::move(item.data);
+  }
+
+  auto parseService = [env](Napi::Object item, Service &service) {
+    return ParseService(env, item, service);
+  };
+  return GetList(env, obj, "advertisedServices", peripheral.advertisedServices,
+                 parseService) &&
+         GetList(env, obj, "services", peripheral.services, parseService);
+}
+
+// Offsets a colon separated MAC address, so templated peripherals are unique
+static std::string OffsetAddress(const std::string &address, uint32_t offset) {
+  uint64_t value = 0;
+  for (const unsigned char c : address) {
+    if (std::isxdigit(c)) {
+      const int digit = std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10;
+      value = (value << 4) | uint64_t(digit);
+    }
+  }
+  value = (value + offset) & 0xffffffffffffULL;
+
+  char result[18];
+  snprintf(result, sizeof(result), "%02X:%02X:%02X:%02X:%02X:%02X",
+           unsigned(value >> 40) & 0xff, unsigned(value >> 32) & 0xff,
+           unsigned(value >> 24) & 0xff, unsigned(value >> 16) & 0xff,
+           unsigned(value >> 8) & 0xff, unsigned(value) & 0xff);
+  return result;
+}
+
+static Napi::Value ConfigureWorld(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "Invalid config").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  const Napi::Object obj = info[0].As<Napi::Object>();
+  Config config;
+  uint32_t adapters = uint32_t(config.adapters);
+  if (!GetUint32(env, obj, "adapters", adapters) ||
+      !GetUint32(env, obj, "seed", config.seed)) {
+    return env.Undefined();
+  }
+  config.adapters = adapters;
+
+  // A peripheral with a count is a template for that many peripherals,
+  // numbered after their identifier with consecutive addresses
+  struct Template {
+    Peripheral peripheral;
+    uint32_t count = 1;
+  };
+  std::vector<Template> templates;
+  if (!GetList(env, obj, "peripherals", templates,
+               [env](Napi::Object item, Template &value) {
+                 return ParsePeripheral(env, item, value.peripheral) &&
+                        GetUint32(env, item, "count", value.count);
+               })) {
+    return env.Undefined();
+  }
+
+  for (const auto &item : templates) {
+    for (uint32_t i = 0; i < item.count; i++) {
+      Peripheral peripheral = item.peripheral;
+      if (item.count > 1) {
+        peripheral.identifier += " " + std::to_string(i);
+        peripheral.address = OffsetAddress(peripheral.address, i);
+      }
+      config.peripherals.push_back(std::move(peripheral));
+    }
+  }
+
+  simulator::Configure(config);
+  return env.Undefined();
+}
+
+static Napi::Value DisconnectPeripheral(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "Invalid address").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  const bool disconnected =
+      simulator::Disconnect(info[0].As<Napi::String>().Utf8Value());
+  return Napi::Boolean::New(env, disconnected);
+}
+
+void Init(Napi::Env env, Napi::Object exports) {
+  Napi::Object simulator = Napi::Object::New(env);
+  simulator.Set("configure", Napi::Function::New(env, ConfigureWorld));
+  simulator.Set("disconnect", Napi::Function::New(env, DisconnectPeripheral));
+  exports.Set("simulator", simulator);
+}
+
+} // namespace simulator
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <napi.h>
+
+namespace simulator {
+
+// Exports `simulator.configure(config)` and `simulator.disconnect(address)`
+// for scripting the simulated world from JS.
+void Init(Napi::Env env, Napi::Object exports);
+
+} // namespace simulator
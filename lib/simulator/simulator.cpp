@@ -0,0 +1,1073 @@
+#include "simulator.h"
+#include <simpleble_c/simpleble.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <set>
+#include <thread>
+
+namespace simulator {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using AdapterCallback = void (*)(simpleble_adapter_t, void *);
+using ScanCallback = void (*)(simpleble_adapter_t, simpleble_peripheral_t,
+                              void *);
+using PeripheralCallback = void (*)(simpleble_peripheral_t, void *);
+using DataCallback = void (*)(simpleble_uuid_t, simpleble_uuid_t,
+                              const uint8_t *, size_t, void *);
+
+// Runs timed events in order on one thread, standing in for SimpleBLE's event
+// thread
+class Scheduler {
+public:
+  static Scheduler &Get() {
+    static Scheduler scheduler;
+    return scheduler;
+  }
+
+  void After(uint32_t ms, std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->events.push({Clock::now() + std::chrono::milliseconds(ms),
+                       this->sequence++, std::move(fn)});
+    if (!this->thread.joinable()) {
+      this->thread = std::thread(&Scheduler::Run, this);
+    }
+    this->wake.notify_one();
+  }
+
+private:
+  struct Event {
+    Clock::time_point time;
+    uint64_t sequence;
+    std::function<void()> fn;
+
+    bool operator>(const Event &other) const {
+      return this->time != other.time ? this->time > other.time
+                                      : this->sequence > other.sequence;
+    }
+  };
+
+  ~Scheduler() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->stopping = true;
+    }
+    this->wake.notify_one();
+    if (this->thread.joinable()) {
+      this->thread.join();
+    }
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopping) {
+      if (this->events.empty()) {
+        this->wake.wait(lock);
+        continue;
+      }
+
+      const auto next = this->events.top().time;
+      if (Clock::now() < next) {
+        this->wake.wait_until(lock, next);
+        continue;
+      }
+
+      auto fn = this->events.top().fn;
+      this->events.pop();
+      lock.unlock();
+      fn();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+  uint64_t sequence = 0;
+  bool stopping = false;
+  std::thread thread;
+};
+
+struct Device {
+  // Characteristic and descriptor values are updated by writes
+  Peripheral config;
+  std::mutex mutex;
+  bool connected = false;
+  // Bumped on every connect and disconnect, so timers armed for an earlier
+  // link do nothing
+  uint64_t link = 0;
+  uint32_t failures = 0;
+  int16_t rssi = 0;
+
+  PeripheralCallback onConnected = nullptr;
+  void *onConnectedData = nullptr;
+  simpleble_peripheral_t onConnectedHandle = nullptr;
+  PeripheralCallback onDisconnected = nullptr;
+  void *onDisconnectedData = nullptr;
+  simpleble_peripheral_t onDisconnectedHandle = nullptr;
+
+  struct Listener {
+    DataCallback callback;
+    void *userdata;
+    uint64_t id;
+    uint32_t sequence;
+  };
+  std::map<std::string, Listener> listeners;
+  uint64_t listenerId = 0;
+
+  // Held while a listener runs, so none is called once unsubscribe returns
+  std::mutex delivery;
+};
+
+struct Adapter {
+  size_t index = 0;
+  uint64_t generation = 0;
+  std::mutex mutex;
+  bool scanning = false;
+  uint64_t scan = 0;
+
+  AdapterCallback onScanStart = nullptr;
+  void *onScanStartData = nullptr;
+  AdapterCallback onScanStop = nullptr;
+  void *onScanStopData = nullptr;
+  ScanCallback onScanUpdated = nullptr;
+  void *onScanUpdatedData = nullptr;
+  ScanCallback onScanFound = nullptr;
+  void *onScanFoundData = nullptr;
+
+  std::vector<std::shared_ptr<Device>> results;
+  std::set<std::string> seen;
+};
+
+using DeviceHandle = std::shared_ptr<Device>;
+using AdapterHandle = std::shared_ptr<Adapter>;
+
+struct World {
+  std::mutex mutex;
+  uint64_t generation = 0;
+  std::mt19937 random;
+  std::vector<AdapterHandle> adapters;
+  std::vector<DeviceHandle> devices;
+};
+
+World &GetWorld() {
+  static World world;
+  return world;
+}
+
+Device &GetDevice(simpleble_peripheral_t handle) {
+  return **static_cast<DeviceHandle *>(handle);
+}
+
+Adapter &GetAdapter(simpleble_adapter_t handle) {
+  return **static_cast<AdapterHandle *>(handle);
+}
+
+void Sleep(uint32_t ms) {
+  if (ms > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+char *CopyString(const std::string &value) {
+  auto str = static_cast<char *>(std::malloc(value.size() + 1));
+  std::memcpy(str, value.c_str(), value.size() + 1);
+  return str;
+}
+
+void CopyUuid(const std::string &value, simpleble_uuid_t &uuid) {
+  std::memset(uuid.value, 0, SIMPLEBLE_UUID_STR_LEN);
+  std::memcpy(uuid.value, value.c_str(),
+              std::min(value.size(), size_t(SIMPLEBLE_UUID_STR_LEN - 1)));
+}
+
+bool SameUuid(const std::string &a, const char *b) {
+  const size_t length = strnlen(b, SIMPLEBLE_UUID_STR_LEN);
+  return a.size() == length &&
+         std::equal(a.begin(), a.end(), b, [](char x, char y) {
+           return std::tolower(x) == std::tolower(y);
+         });
+}
+
+std::string Key(const simpleble_uuid_t &service,
+                const simpleble_uuid_t &characteristic) {
+  return std::string(service.value) + "/" + characteristic.value;
+}
+
+Characteristic *FindCharacteristic(Device &device,
+                                   const simpleble_uuid_t &service,
+                                   const simpleble_uuid_t &characteristic) {
+  for (auto &s : device.config.services) {
+    if (!SameUuid(s.uuid, service.value)) {
+      continue;
+    }
+    for (auto &c : s.characteristics) {
+      if (SameUuid(c.uuid, characteristic.value)) {
+        return &c;
+      }
+    }
+  }
+  return nullptr;
+}
+
+Descriptor *FindDescriptor(Device &device, const simpleble_uuid_t &service,
+                           const simpleble_uuid_t &characteristic,
+                           const simpleble_uuid_t &descriptor) {
+  auto c = FindCharacteristic(device, service, characteristic);
+  if (c == nullptr) {
+    return nullptr;
+  }
+  for (auto &d : c->descriptors) {
+    if (SameUuid(d.uuid, descriptor.value)) {
+      return &d;
+    }
+  }
+  return nullptr;
+}
+
+// Drops the link, only if it is still the one given when that is non-zero
+bool DropLink(const DeviceHandle &device, uint64_t link = 0) {
+  PeripheralCallback callback;
+  void *userdata;
+  simpleble_peripheral_t handle;
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    if (!device->connected || (link != 0 && device->link != link)) {
+      return false;
+    }
+    device->connected = false;
+    device->link++;
+    device->listeners.clear();
+    callback = device->onDisconnected;
+    userdata = device->onDisconnectedData;
+    handle = device->onDisconnectedHandle;
+  }
+
+  if (callback != nullptr) {
+    Scheduler::Get().After(0, [=] { callback(handle, userdata); });
+  }
+  return true;
+}
+
+// Sends the listener a payload if it is still subscribed under the same id
+bool Deliver(const DeviceHandle &device, const std::string &key, uint64_t id,
+             const std::vector<uint8_t> *value, size_t length) {
+  std::lock_guard<std::mutex> delivery(device->delivery);
+
+  Device::Listener listener;
+  std::vector<uint8_t> payload;
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    auto it = device->listeners.find(key);
+    if (!device->connected || it == device->listeners.end() ||
+        it->second.id != id) {
+      return false;
+    }
+
+    if (value != nullptr) {
+      payload = *value;
+    } else {
+      // Little endian sequence number, so drops and reordering are visible,
+      // then the send time when there is room for it
+      payload.assign(std::max(length, size_t(4)), 0);
+      const uint32_t sequence = it->second.sequence++;
+      for (size_t i = 0; i < 4; i++) {
+        payload[i] = uint8_t(sequence >> (8 * i));
+      }
+      if (payload.size() >= 12) {
+        const double sent =
+            std::chrono::duration<double, std::milli>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        uint64_t bits;
+        std::memcpy(&bits, &sent, sizeof(bits));
+        for (size_t i = 0; i < 8; i++) {
+          payload[4 + i] = uint8_t(bits >> (8 * i));
+        }
+      }
+    }
+    listener = it->second;
+  }
+
+  const auto separator = key.find('/');
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  CopyUuid(key.substr(0, separator), service);
+  CopyUuid(key.substr(separator + 1), characteristic);
+  listener.callback(service, characteristic, payload.data(), payload.size(),
+                    listener.userdata);
+  return true;
+}
+
+void Tick(std::weak_ptr<Device> weak, std::string key, uint64_t id,
+          uint32_t interval, size_t length) {
+  auto device = weak.lock();
+  if (device && Deliver(device, key, id, nullptr, length)) {
+    Scheduler::Get().After(interval,
+                           [=] { Tick(weak, key, id, interval, length); });
+  }
+}
+
+void Advertise(std::weak_ptr<Adapter> weakAdapter,
+               std::weak_ptr<Device> weakDevice, uint64_t scan) {
+  auto adapter = weakAdapter.lock();
+  auto device = weakDevice.lock();
+  if (!adapter || !device) {
+    return;
+  }
+
+  uint32_t interval;
+  std::string address;
+  int16_t rssi;
+  {
+    auto &world = GetWorld();
+    std::lock_guard<std::mutex> lock(world.mutex);
+    if (adapter->generation != world.generation) {
+      return;
+    }
+    std::lock_guard<std::mutex> deviceLock(device->mutex);
+    interval = std::max<uint32_t>(device->config.advertisingInterval, 1);
+    address = device->config.address;
+    // A few dB of jitter, as a real radio reports
+    rssi = device->config.rssi + int16_t(world.random() % 7) - 3;
+    device->rssi = rssi;
+  }
+
+  ScanCallback callback;
+  void *userdata;
+  {
+    std::lock_guard<std::mutex> lock(adapter->mutex);
+    if (!adapter->scanning || adapter->scan != scan) {
+      return;
+    }
+
+    const bool found = adapter->seen.insert(address).second;
+    if (found) {
+      adapter->results.push_back(device);
+    }
+    callback = found ? adapter->onScanFound : adapter->onScanUpdated;
+    userdata = found ? adapter->onScanFoundData : adapter->onScanUpdatedData;
+  }
+
+  // As with SimpleBLE, the receiver owns the handles it is given
+  if (callback != nullptr) {
+    callback(new AdapterHandle(adapter), new DeviceHandle(device), userdata);
+  }
+
+  Scheduler::Get().After(interval,
+                         [=] { Advertise(weakAdapter, weakDevice, scan); });
+}
+
+void StartScan(const AdapterHandle &adapter) {
+  AdapterCallback callback;
+  void *userdata;
+  uint64_t scan;
+  {
+    std::lock_guard<std::mutex> lock(adapter->mutex);
+    adapter->scanning = true;
+    scan = ++adapter->scan;
+    adapter->results.clear();
+    adapter->seen.clear();
+    callback = adapter->onScanStart;
+    userdata = adapter->onScanStartData;
+  }
+
+  if (callback != nullptr) {
+    Scheduler::Get().After(
+        0, [=] { callback(new AdapterHandle(adapter), userdata); });
+  }
+
+  auto &world = GetWorld();
+  std::lock_guard<std::mutex> lock(world.mutex);
+  for (auto &device : world.devices) {
+    // Spread the first advertisements over one interval
+    const uint32_t interval =
+        std::max<uint32_t>(device->config.advertisingInterval, 1);
+    std::weak_ptr<Adapter> weakAdapter = adapter;
+    std::weak_ptr<Device> weakDevice = device;
+    Scheduler::Get().After(world.random() % interval, [=] {
+      Advertise(weakAdapter, weakDevice, scan);
+    });
+  }
+}
+
+void StopScan(const AdapterHandle &adapter) {
+  AdapterCallback callback;
+  void *userdata;
+  {
+    std::lock_guard<std::mutex> lock(adapter->mutex);
+    if (!adapter->scanning) {
+      return;
+    }
+    adapter->scanning = false;
+    callback = adapter->onScanStop;
+    userdata = adapter->onScanStopData;
+  }
+
+  if (callback != nullptr) {
+    Scheduler::Get().After(
+        0, [=] { callback(new AdapterHandle(adapter), userdata); });
+  }
+}
+
+} // namespace
+
+void Configure(const Config &config) {
+  auto &world = GetWorld();
+  std::vector<DeviceHandle> previous;
+  {
+    std::lock_guard<std::mutex> lock(world.mutex);
+    world.generation++;
+    world.random.seed(config.seed);
+    previous.swap(world.devices);
+
+    // Adapters keep their identity while the count allows, as the bindings
+    // hold on to them, but forget any scan in progress
+    world.adapters.resize(std::min(world.adapters.size(), config.adapters));
+    for (auto &adapter : world.adapters) {
+      std::lock_guard<std::mutex> adapterLock(adapter->mutex);
+      adapter->generation = world.generation;
+      adapter->scanning = false;
+      adapter->scan++;
+      adapter->results.clear();
+      adapter->seen.clear();
+    }
+    for (size_t i = world.adapters.size(); i < config.adapters; i++) {
+      auto adapter = std::make_shared<Adapter>();
+      adapter->index = i;
+      adapter->generation = world.generation;
+      world.adapters.push_back(adapter);
+    }
+
+    for (const auto &peripheral : config.peripherals) {
+      auto device = std::make_shared<Device>();
+      device->config = peripheral;
+      device->rssi = peripheral.rssi;
+      world.devices.push_back(device);
+    }
+  }
+
+  for (auto &device : previous) {
+    DropLink(device);
+  }
+}
+
+bool Disconnect(const std::string &address) {
+  auto &world = GetWorld();
+  DeviceHandle device;
+  {
+    std::lock_guard<std::mutex> lock(world.mutex);
+    for (auto &d : world.devices) {
+      if (d->config.address == address) {
+        device = d;
+        break;
+      }
+    }
+  }
+
+  return device && DropLink(device);
+}
+
+} // namespace simulator
+
+using namespace simulator;
+
+extern "C" {
+
+void simpleble_free(void *handle) { std::free(handle); }
+
+bool simpleble_adapter_is_bluetooth_enabled(void) { return true; }
+
+size_t simpleble_adapter_get_count(void) {
+  auto &world = GetWorld();
+  std::lock_guard<std::mutex> lock(world.mutex);
+  return world.adapters.size();
+}
+
+simpleble_adapter_t simpleble_adapter_get_handle(size_t index) {
+  auto &world = GetWorld();
+  std::lock_guard<std::mutex> lock(world.mutex);
+  if (index >= world.adapters.size()) {
+    return nullptr;
+  }
+  return new AdapterHandle(world.adapters[index]);
+}
+
+void simpleble_adapter_release_handle(simpleble_adapter_t handle) {
+  delete static_cast<AdapterHandle *>(handle);
+}
+
+char *simpleble_adapter_identifier(simpleble_adapter_t handle) {
+  return CopyString("Simulated Adapter " +
+                    std::to_string(GetAdapter(handle).index));
+}
+
+char *simpleble_adapter_address(simpleble_adapter_t handle) {
+  char address[18];
+  snprintf(address, sizeof(address), "00:00:00:00:00:%02X",
+           unsigned(GetAdapter(handle).index & 0xff));
+  return CopyString(address);
+}
+
+simpleble_err_t simpleble_adapter_scan_start(simpleble_adapter_t handle) {
+  StartScan(*static_cast<AdapterHandle *>(handle));
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_adapter_scan_stop(simpleble_adapter_t handle) {
+  StopScan(*static_cast<AdapterHandle *>(handle));
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_adapter_scan_is_active(simpleble_adapter_t handle,
+                                                 bool *active) {
+  auto &adapter = GetAdapter(handle);
+  std::lock_guard<std::mutex> lock(adapter.mutex);
+  *active = adapter.scanning;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_adapter_scan_for(simpleble_adapter_t handle,
+                                           int timeout_ms) {
+  StartScan(*static_cast<AdapterHandle *>(handle));
+  Sleep(uint32_t(std::max(timeout_ms, 0)));
+  StopScan(*static_cast<AdapterHandle *>(handle));
+  return SIMPLEBLE_SUCCESS;
+}
+
+size_t simpleble_adapter_scan_get_results_count(simpleble_adapter_t handle) {
+  auto &adapter = GetAdapter(handle);
+  std::lock_guard<std::mutex> lock(adapter.mutex);
+  return adapter.results.size();
+}
+
+simpleble_peripheral_t
+simpleble_adapter_scan_get_results_handle(simpleble_adapter_t handle,
+                                          size_t index) {
+  auto &adapter = GetAdapter(handle);
+  std::lock_guard<std::mutex> lock(adapter.mutex);
+  if (index >= adapter.results.size()) {
+    return nullptr;
+  }
+  return new DeviceHandle(adapter.results[index]);
+}
+
+static std::vector<DeviceHandle> PairedDevices() {
+  auto &world = GetWorld();
+  std::lock_guard<std::mutex> lock(world.mutex);
+  std::vector<DeviceHandle> paired;
+  for (auto &device : world.devices) {
+    std::lock_guard<std::mutex> deviceLock(device->mutex);
+    if (device->config.paired) {
+      paired.push_back(device);
+    }
+  }
+  return paired;
+}
+
+size_t simpleble_adapter_get_paired_peripherals_count(
+    simpleble_adapter_t handle) {
+  return PairedDevices().size();
+}
+
+simpleble_peripheral_t
+simpleble_adapter_get_paired_peripherals_handle(simpleble_adapter_t handle,
+                                                size_t index) {
+  const auto paired = PairedDevices();
+  return index < paired.size() ? new DeviceHandle(paired[index]) : nullptr;
+}
+
+simpleble_err_t simpleble_adapter_set_callback_on_scan_start(
+    simpleble_adapter_t handle,
+    void (*callback)(simpleble_adapter_t adapter, void *userdata),
+    void *userdata) {
+  auto &adapter = GetAdapter(handle);
+  std::lock_guard<std::mutex> lock(adapter.mutex);
+  adapter.onScanStart = callback;
+  adapter.onScanStartData = userdata;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_adapter_set_callback_on_scan_stop(
+    simpleble_adapter_t handle,
+    void (*callback)(simpleble_adapter_t adapter, void *userdata),
+    void *userdata) {
+  auto &adapter = GetAdapter(handle);
+  std::lock_guard<std::mutex> lock(adapter.mutex);
+  adapter.onScanStop = callback;
+  adapter.onScanStopData = userdata;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_adapter_set_callback_on_scan_updated(
+    simpleble_adapter_t handle,
+    void (*callback)(simpleble_adapter_t adapter,
+                     simpleble_peripheral_t peripheral, void *userdata),
+    void *userdata) {
+  auto &adapter = GetAdapter(handle);
+  std::lock_guard<std::mutex> lock(adapter.mutex);
+  adapter.onScanUpdated = callback;
+  adapter.onScanUpdatedData = userdata;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_adapter_set_callback_on_scan_found(
+    simpleble_adapter_t handle,
+    void (*callback)(simpleble_adapter_t adapter,
+                     simpleble_peripheral_t peripheral, void *userdata),
+    void *userdata) {
+  auto &adapter = GetAdapter(handle);
+  std::lock_guard<std::mutex> lock(adapter.mutex);
+  adapter.onScanFound = callback;
+  adapter.onScanFoundData = userdata;
+  return SIMPLEBLE_SUCCESS;
+}
+
+void simpleble_peripheral_release_handle(simpleble_peripheral_t handle) {
+  delete static_cast<DeviceHandle *>(handle);
+}
+
+char *simpleble_peripheral_identifier(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return CopyString(device.config.identifier);
+}
+
+char *simpleble_peripheral_address(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return CopyString(device.config.address);
+}
+
+simpleble_address_type_t
+simpleble_peripheral_address_type(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return device.config.addressType;
+}
+
+int16_t simpleble_peripheral_rssi(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return device.rssi;
+}
+
+int16_t simpleble_peripheral_tx_power(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return device.config.txPower;
+}
+
+uint16_t simpleble_peripheral_mtu(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return device.connected ? device.config.mtu : 0;
+}
+
+simpleble_err_t simpleble_peripheral_connect(simpleble_peripheral_t handle) {
+  const auto &device = *static_cast<DeviceHandle *>(handle);
+
+  uint32_t latency;
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    if (device->connected) {
+      return SIMPLEBLE_SUCCESS;
+    }
+    latency = device->config.connectLatency;
+  }
+  Sleep(latency);
+
+  PeripheralCallback callback;
+  void *userdata;
+  simpleble_peripheral_t callbackHandle;
+  uint64_t link;
+  uint32_t disconnectAfter;
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    if (!device->config.connectable) {
+      return SIMPLEBLE_FAILURE;
+    }
+    if (device->failures < device->config.connectFailures) {
+      device->failures++;
+      return SIMPLEBLE_FAILURE;
+    }
+
+    device->connected = true;
+    link = ++device->link;
+    disconnectAfter = device->config.disconnectAfter;
+    callback = device->onConnected;
+    userdata = device->onConnectedData;
+    callbackHandle = device->onConnectedHandle;
+  }
+
+  if (disconnectAfter > 0) {
+    std::weak_ptr<Device> weak = device;
+    Scheduler::Get().After(disconnectAfter, [weak, link] {
+      if (auto device = weak.lock()) {
+        DropLink(device, link);
+      }
+    });
+  }
+
+  if (callback != nullptr) {
+    Scheduler::Get().After(0, [=] { callback(callbackHandle, userdata); });
+  }
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_disconnect(simpleble_peripheral_t handle) {
+  DropLink(*static_cast<DeviceHandle *>(handle));
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_is_connected(simpleble_peripheral_t handle,
+                                                  bool *connected) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  *connected = device.connected;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t
+simpleble_peripheral_is_connectable(simpleble_peripheral_t handle,
+                                    bool *connectable) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  *connectable = device.config.connectable;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_is_paired(simpleble_peripheral_t handle,
+                                               bool *paired) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  *paired = device.config.paired;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_unpair(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  device.config.paired = false;
+  return SIMPLEBLE_SUCCESS;
+}
+
+// Connected peripherals expose their GATT database, others what they advertise
+static const std::vector<Service> &VisibleServices(Device &device) {
+  return device.connected ? device.config.services
+                          : device.config.advertisedServices;
+}
+
+size_t simpleble_peripheral_services_count(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return VisibleServices(device).size();
+}
+
+simpleble_err_t
+simpleble_peripheral_services_get(simpleble_peripheral_t handle, size_t index,
+                                  simpleble_service_t *services) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  const auto &visible = VisibleServices(device);
+  if (index >= visible.size()) {
+    return SIMPLEBLE_FAILURE;
+  }
+
+  const Service &service = visible[index];
+  CopyUuid(service.uuid, services->uuid);
+  services->data_length = std::min(service.data.size(), sizeof(services->data));
+  std::memcpy(services->data, service.data.data(), services->data_length);
+
+  services->characteristic_count =
+      std::min(service.characteristics.size(),
+               size_t(SIMPLEBLE_CHARACTERISTIC_MAX_COUNT));
+  for (size_t i = 0; i < services->characteristic_count; i++) {
+    const Characteristic &from = service.characteristics[i];
+    simpleble_characteristic_t &to = services->characteristics[i];
+    CopyUuid(from.uuid, to.uuid);
+    to.can_read = from.canRead;
+    to.can_write_request = from.canWriteRequest;
+    to.can_write_command = from.canWriteCommand;
+    to.can_notify = from.canNotify;
+    to.can_indicate = from.canIndicate;
+    to.descriptor_count = std::min(from.descriptors.size(),
+                                   size_t(SIMPLEBLE_DESCRIPTOR_MAX_COUNT));
+    for (size_t j = 0; j < to.descriptor_count; j++) {
+      CopyUuid(from.descriptors[j].uuid, to.descriptors[j].uuid);
+    }
+  }
+
+  return SIMPLEBLE_SUCCESS;
+}
+
+size_t
+simpleble_peripheral_manufacturer_data_count(simpleble_peripheral_t handle) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return device.config.manufacturerData.size();
+}
+
+simpleble_err_t simpleble_peripheral_manufacturer_data_get(
+    simpleble_peripheral_t handle, size_t index,
+    simpleble_manufacturer_data_t *manufacturer_data) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  if (index >= device.config.manufacturerData.size()) {
+    return SIMPLEBLE_FAILURE;
+  }
+
+  auto it = std::next(device.config.manufacturerData.begin(), index);
+  manufacturer_data->manufacturer_id = it->first;
+  manufacturer_data->data_length =
+      std::min(it->second.size(), sizeof(manufacturer_data->data));
+  std::memcpy(manufacturer_data->data, it->second.data(),
+              manufacturer_data->data_length);
+  return SIMPLEBLE_SUCCESS;
+}
+
+static simpleble_err_t ReadValue(simpleble_peripheral_t handle,
+                                 const std::vector<uint8_t> *(*find)(
+                                     Device &, const simpleble_uuid_t *),
+                                 const simpleble_uuid_t *uuids, uint8_t **data,
+                                 size_t *data_length) {
+  auto &device = GetDevice(handle);
+
+  uint32_t latency;
+  {
+    std::lock_guard<std::mutex> lock(device.mutex);
+    latency = device.config.readLatency;
+  }
+  Sleep(latency);
+
+  std::lock_guard<std::mutex> lock(device.mutex);
+  const std::vector<uint8_t> *value =
+      device.connected ? find(device, uuids) : nullptr;
+  if (value == nullptr) {
+    return SIMPLEBLE_FAILURE;
+  }
+
+  *data_length = value->size();
+  *data =
+      static_cast<uint8_t *>(std::malloc(std::max(value->size(), size_t(1))));
+  std::memcpy(*data, value->data(), value->size());
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_read(simpleble_peripheral_t handle,
+                                          simpleble_uuid_t service,
+                                          simpleble_uuid_t characteristic,
+                                          uint8_t **data,
+                                          size_t *data_length) {
+  const simpleble_uuid_t uuids[] = {service, characteristic};
+  return ReadValue(
+      handle,
+      [](Device &device,
+         const simpleble_uuid_t *uuids) -> const std::vector<uint8_t> * {
+        auto c = FindCharacteristic(device, uuids[0], uuids[1]);
+        return c != nullptr && c->canRead ? &c->value : nullptr;
+      },
+      uuids, data, data_length);
+}
+
+simpleble_err_t simpleble_peripheral_read_descriptor(
+    simpleble_peripheral_t handle, simpleble_uuid_t service,
+    simpleble_uuid_t characteristic, simpleble_uuid_t descriptor,
+    uint8_t **data, size_t *data_length) {
+  const simpleble_uuid_t uuids[] = {service, characteristic, descriptor};
+  return ReadValue(
+      handle,
+      [](Device &device,
+         const simpleble_uuid_t *uuids) -> const std::vector<uint8_t> * {
+        auto d = FindDescriptor(device, uuids[0], uuids[1], uuids[2]);
+        return d != nullptr ? &d->value : nullptr;
+      },
+      uuids, data, data_length);
+}
+
+static simpleble_err_t WriteValue(simpleble_peripheral_t handle,
+                                  simpleble_uuid_t service,
+                                  simpleble_uuid_t characteristic,
+                                  const uint8_t *data, size_t data_length,
+                                  bool request) {
+  const auto &device = *static_cast<DeviceHandle *>(handle);
+
+  // Commands aren't acknowledged, only requests wait out the latency
+  if (request) {
+    uint32_t latency;
+    {
+      std::lock_guard<std::mutex> lock(device->mutex);
+      latency = device->config.writeLatency;
+    }
+    Sleep(latency);
+  }
+
+  const std::string key = Key(service, characteristic);
+  std::vector<uint8_t> value(data, data + data_length);
+  uint64_t echo = 0;
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    auto c = device->connected
+                 ? FindCharacteristic(*device, service, characteristic)
+                 : nullptr;
+    if (c == nullptr || (request ? !c->canWriteRequest : !c->canWriteCommand)) {
+      return SIMPLEBLE_FAILURE;
+    }
+    c->value = value;
+
+    auto it = device->listeners.find(key);
+    if (c->notifyInterval == 0 && it != device->listeners.end()) {
+      echo = it->second.id;
+    }
+  }
+
+  if (echo != 0) {
+    std::weak_ptr<Device> weak = device;
+    Scheduler::Get().After(0, [weak, key, echo, value] {
+      if (auto device = weak.lock()) {
+        Deliver(device, key, echo, &value, 0);
+      }
+    });
+  }
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_write_request(
+    simpleble_peripheral_t handle, simpleble_uuid_t service,
+    simpleble_uuid_t characteristic, const uint8_t *data, size_t data_length) {
+  return WriteValue(handle, service, characteristic, data, data_length, true);
+}
+
+simpleble_err_t simpleble_peripheral_write_command(
+    simpleble_peripheral_t handle, simpleble_uuid_t service,
+    simpleble_uuid_t characteristic, const uint8_t *data, size_t data_length) {
+  return WriteValue(handle, service, characteristic, data, data_length, false);
+}
+
+simpleble_err_t simpleble_peripheral_write_descriptor(
+    simpleble_peripheral_t handle, simpleble_uuid_t service,
+    simpleble_uuid_t characteristic, simpleble_uuid_t descriptor,
+    const uint8_t *data, size_t data_length) {
+  auto &device = GetDevice(handle);
+
+  uint32_t latency;
+  {
+    std::lock_guard<std::mutex> lock(device.mutex);
+    latency = device.config.writeLatency;
+  }
+  Sleep(latency);
+
+  std::lock_guard<std::mutex> lock(device.mutex);
+  auto d = device.connected
+               ? FindDescriptor(device, service, characteristic, descriptor)
+               : nullptr;
+  if (d == nullptr) {
+    return SIMPLEBLE_FAILURE;
+  }
+  d->value.assign(data, data + data_length);
+  return SIMPLEBLE_SUCCESS;
+}
+
+static simpleble_err_t Subscribe(simpleble_peripheral_t handle,
+                                 simpleble_uuid_t service,
+                                 simpleble_uuid_t characteristic,
+                                 DataCallback callback, void *userdata,
+                                 bool indicate) {
+  const auto &device = *static_cast<DeviceHandle *>(handle);
+  const std::string key = Key(service, characteristic);
+
+  // Waits out a delivery to the listener being replaced
+  std::lock_guard<std::mutex> delivery(device->delivery);
+
+  uint64_t id;
+  uint32_t interval;
+  size_t length;
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    auto c = device->connected
+                 ? FindCharacteristic(*device, service, characteristic)
+                 : nullptr;
+    if (c == nullptr || (indicate ? !c->canIndicate : !c->canNotify)) {
+      return SIMPLEBLE_FAILURE;
+    }
+
+    id = ++device->listenerId;
+    device->listeners[key] = {callback, userdata, id, 0};
+    interval = c->notifyInterval;
+    length = c->notifyLength;
+  }
+
+  if (interval > 0) {
+    std::weak_ptr<Device> weak = device;
+    Scheduler::Get().After(
+        interval, [=] { Tick(weak, key, id, interval, length); });
+  }
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_notify(
+    simpleble_peripheral_t handle, simpleble_uuid_t service,
+    simpleble_uuid_t characteristic,
+    void (*callback)(simpleble_uuid_t service, simpleble_uuid_t characteristic,
+                     const uint8_t *data, size_t data_length, void *userdata),
+    void *userdata) {
+  return Subscribe(handle, service, characteristic, callback, userdata, false);
+}
+
+simpleble_err_t simpleble_peripheral_indicate(
+    simpleble_peripheral_t handle, simpleble_uuid_t service,
+    simpleble_uuid_t characteristic,
+    void (*callback)(simpleble_uuid_t service, simpleble_uuid_t characteristic,
+                     const uint8_t *data, size_t data_length, void *userdata),
+    void *userdata) {
+  return Subscribe(handle, service, characteristic, callback, userdata, true);
+}
+
+simpleble_err_t simpleble_peripheral_unsubscribe(
+    simpleble_peripheral_t handle, simpleble_uuid_t service,
+    simpleble_uuid_t characteristic) {
+  auto &device = GetDevice(handle);
+
+  std::lock_guard<std::mutex> delivery(device.delivery);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  return device.listeners.erase(Key(service, characteristic)) > 0
+             ? SIMPLEBLE_SUCCESS
+             : SIMPLEBLE_FAILURE;
+}
+
+simpleble_err_t simpleble_peripheral_set_callback_on_connected(
+    simpleble_peripheral_t handle,
+    void (*callback)(simpleble_peripheral_t peripheral, void *userdata),
+    void *userdata) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  device.onConnected = callback;
+  device.onConnectedData = userdata;
+  device.onConnectedHandle = handle;
+  return SIMPLEBLE_SUCCESS;
+}
+
+simpleble_err_t simpleble_peripheral_set_callback_on_disconnected(
+    simpleble_peripheral_t handle,
+    void (*callback)(simpleble_peripheral_t peripheral, void *userdata),
+    void *userdata) {
+  auto &device = GetDevice(handle);
+  std::lock_guard<std::mutex> lock(device.mutex);
+  device.onDisconnected = callback;
+  device.onDisconnectedData = userdata;
+  device.onDisconnectedHandle = handle;
+  return SIMPLEBLE_SUCCESS;
+}
+
+} // extern "C"
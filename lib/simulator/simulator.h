@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <simpleble_c/types.h>
+#include <string>
+#include <vector>
+
+// In-process stand-in for SimpleBLE, built instead of the real library when
+// SIMPLEBLE_NODE_SIMULATOR is set. It implements the SimpleBLE C API on top of
+// scripted advertisers and GATT servers, so the bindings run unchanged
+// without radios. Callbacks are made from a single scheduler thread, as
+// SimpleBLE makes them from its own event thread.
+namespace simulator {
+
+struct Descriptor {
+  std::string uuid;
+  std::vector<uint8_t> value;
+};
+
+struct Characteristic {
+  std::string uuid;
+  bool canRead = true;
+  bool canWriteRequest = true;
+  bool canWriteCommand = true;
+  bool canNotify = false;
+  bool canIndicate = false;
+  std::vector<Descriptor> descriptors;
+  std::vector<uint8_t> value;
+  // While subscribed a payload of notifyLength bytes is sent every
+  // notifyInterval milliseconds. It starts with a little endian uint32
+  // sequence number, followed by the send time as a little endian float64 of
+  // milliseconds since the epoch when the length allows. With no interval,
+  // writes are echoed back as notifications instead.
+  uint32_t notifyInterval = 0;
+  size_t notifyLength = 20;
+};
+
+struct Service {
+  std::string uuid;
+  // Service data, only used for advertised services
+  std::vector<uint8_t> data;
+  std::vector<Characteristic> characteristics;
+};
+
+struct Peripheral {
+  std::string identifier;
+  std::string address;
+  simpleble_address_type_t addressType = SIMPLEBLE_ADDRESS_TYPE_PUBLIC;
+  int16_t rssi = -60;
+  int16_t txPower = 0;
+  uint16_t mtu = 247;
+  bool connectable = true;
+  bool paired = false;
+  std::map<uint16_t, std::vector<uint8_t>> manufacturerData;
+  std::vector<Service> advertisedServices;
+  std::vector<Service> services;
+  // Milliseconds between advertisements while scanning
+  uint32_t advertisingInterval = 100;
+
+  // Latencies in milliseconds, spent on the calling thread as SimpleBLE's
+  // blocking calls do
+  uint32_t connectLatency = 0;
+  uint32_t readLatency = 0;
+  uint32_t writeLatency = 0;
+
+  // Faults: drop the link this many milliseconds after connecting, and fail
+  // this many connection attempts before succeeding
+  uint32_t disconnectAfter = 0;
+  uint32_t connectFailures = 0;
+};
+
+struct Config {
+  size_t adapters = 1;
+  uint32_t seed = 1;
+  std::vector<Peripheral> peripherals;
+};
+
+// Replaces the simulated world. Existing connections are dropped and handles
+// from the previous configuration stop receiving callbacks.
+void Configure(const Config &config);
+
+// Drops the connection to the peripheral with the given address, as if the
+// link was lost. Returns false if it isn't connected.
+bool Disconnect(const std::string &address);
+
+} // namespace simulator
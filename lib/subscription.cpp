@@ -0,0 +1,405 @@
+#include "subscription.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+static double Now() {
+  using namespace std::chrono;
+  const auto now = system_clock::now().time_since_epoch();
+  return duration_cast<duration<double, std::milli>>(now).count();
+}
+
+Subscription::Subscription(const Options &options,
+                           std::unique_ptr<PayloadDecoder> payloadDecoder)
+    : options(options),
+      // Decoded payloads never pass through the ring buffer, it only needs a
+      // slot
+      ring(payloadDecoder ? 1 : options.capacity, options.overflow,
+           Payload::Free, std::chrono::milliseconds(options.blockTimeout)),
+      decoder(std::move(payloadDecoder)) {
+  if (this->decoder) {
+    this->columns = this->decoder->Allocate(options.capacity);
+  }
+}
+
+Subscription *Subscription::New(Napi::Env env, Napi::Function callback,
+                                const char *name, const Options &options) {
+  return Start(env, callback, name, new Subscription(options));
+}
+
+Subscription *Subscription::Start(Napi::Env env, Napi::Function callback,
+                                  const char *name,
+                                  Subscription *subscription) {
+  const auto &options = subscription->options;
+  subscription->drainFn = DrainFn::New(
+      env, callback, name, 0, 1, subscription,
+      [](Napi::Env, Subscription *subscription, Subscription *) {
+        delete subscription;
+      },
+      subscription);
+  subscription->drainFn.Unref(env);
+  subscription->listeners.push_back(Napi::Persistent(callback));
+
+  if (options.batched && options.interval > 0) {
+    subscription->flusher = std::thread(&Subscription::Flush, subscription);
+  }
+
+  return subscription;
+}
+
+Subscription *Subscription::NewDecoded(Napi::Env env, Napi::Function callback,
+                                       const char *name,
+                                       const Options &options,
+                                       PayloadDecoder decoder) {
+  auto subscription = new Subscription(
+      options, std::make_unique<PayloadDecoder>(std::move(decoder)));
+  return Start(env, callback, name, subscription);
+}
+
+Subscription *Subscription::NewShared(Napi::Env env, Napi::Int32Array ring,
+                                      const char *name,
+                                      const Options &options) {
+  // Payloads never pass through the ring buffer, it only needs a slot
+  Options sharedOptions = options;
+  sharedOptions.batched = false;
+  sharedOptions.capacity = 1;
+
+  Napi::Function notify = env.Global()
+                              .Get("Atomics")
+                              .As<Napi::Object>()
+                              .Get("notify")
+                              .As<Napi::Function>();
+  auto subscription = New(env, notify, name, sharedOptions);
+
+  // The typed array's own pointer, napi_get_arraybuffer_info rejects a
+  // SharedArrayBuffer
+  auto memory = reinterpret_cast<uint8_t *>(ring.Data());
+  subscription->shared =
+      std::make_unique<SharedRing>(memory, ring.ByteLength());
+  subscription->sharedArray = Napi::Persistent(Napi::Object(ring));
+  return subscription;
+}
+
+bool Subscription::ParseOptions(Napi::Env env, Napi::Object obj,
+                                Options &options) {
+  if (obj.Get("capacity").IsNumber()) {
+    const auto capacity = obj.Get("capacity").As<Napi::Number>().Int64Value();
+    if (capacity < 1) {
+      Napi::RangeError::New(env, "Capacity must be at least 1")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    options.capacity = capacity;
+  }
+
+  if (obj.Get("overflow").IsString()) {
+    const std::string overflow =
+        obj.Get("overflow").As<Napi::String>().Utf8Value();
+    if (overflow == "drop-oldest") {
+      options.overflow = Overflow::DropOldest;
+    } else if (overflow == "drop-newest") {
+      options.overflow = Overflow::DropNewest;
+    } else if (overflow == "block") {
+      options.overflow = Overflow::Block;
+    } else {
+      Napi::RangeError::New(env, "Unknown overflow policy")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+  }
+
+  if (obj.Get("blockTimeout").IsNumber()) {
+    const auto timeout =
+        obj.Get("blockTimeout").As<Napi::Number>().Int64Value();
+    if (timeout < 0) {
+      Napi::RangeError::New(env, "Block timeout must be at least 0")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    options.blockTimeout = uint32_t(timeout);
+  }
+
+  return true;
+}
+
+bool Subscription::ParseBatchOptions(Napi::Env env, Napi::Object obj,
+                                     Options &options) {
+  options.batched = true;
+  if (!ParseOptions(env, obj, options)) {
+    return false;
+  }
+
+  if (obj.Get("count").IsNumber()) {
+    options.count = obj.Get("count").As<Napi::Number>().Uint32Value();
+  }
+  if (obj.Get("interval").IsNumber()) {
+    options.interval = obj.Get("interval").As<Napi::Number>().Uint32Value();
+  }
+
+  if (options.count == 0 && options.interval == 0) {
+    Napi::RangeError::New(env, "Either count or interval must be set")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  // A count the queue can never reach would never flush
+  if (options.count > options.capacity) {
+    Napi::RangeError::New(env, "Count must not exceed capacity")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+
+  return true;
+}
+
+void Subscription::Push(const uint8_t *data, size_t length) {
+  if (this->decoder) {
+    this->received.fetch_add(1, std::memory_order_relaxed);
+    this->metrics->Received(1);
+
+    size_t pending;
+    {
+      std::lock_guard<std::mutex> lock(this->columnsMutex);
+      if (this->columns.rows + this->decoder->Rows(length) >
+          this->options.capacity) {
+        this->decodeDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      this->decoder->Decode(data, length, Now(), this->columns);
+      pending = this->columns.rows;
+    }
+
+    if (this->options.count > 0 && pending >= this->options.count) {
+      Schedule();
+    }
+    return;
+  }
+
+  if (this->shared) {
+    this->received.fetch_add(1, std::memory_order_relaxed);
+    this->metrics->Received(1);
+    if (this->shared->Write(data, length, Now())) {
+      this->delivered.fetch_add(1, std::memory_order_relaxed);
+      this->metrics->Delivered(1);
+      if (this->options.wake) {
+        Schedule();
+      }
+    }
+    return;
+  }
+
+  auto payload = Payload::Create(data, length);
+  if (payload == nullptr) {
+    return;
+  }
+
+  payload->timestamp = Now();
+  this->received.fetch_add(1, std::memory_order_relaxed);
+  this->metrics->Received(1);
+  this->ring.Push(payload);
+
+  if (!this->options.batched ||
+      (this->options.count > 0 && this->ring.Size() >= this->options.count)) {
+    Schedule();
+  }
+}
+
+void Subscription::Close() {
+  // First, a producer blocked on a full ring is waiting for JS
+  this->ring.Close();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->closed = true;
+  }
+  this->wake.notify_all();
+
+  if (this->flusher.joinable()) {
+    this->flusher.join();
+  }
+
+  this->drainFn.Release();
+}
+
+bool Subscription::AddListener(Napi::Function callback) {
+  for (const auto &listener : this->listeners) {
+    if (listener.Value().StrictEquals(callback)) {
+      return false;
+    }
+  }
+
+  this->listeners.push_back(Napi::Persistent(callback));
+  return true;
+}
+
+size_t Subscription::RemoveListener(Napi::Function callback) {
+  for (auto it = this->listeners.begin(); it != this->listeners.end(); ++it) {
+    if (it->Value().StrictEquals(callback)) {
+      this->listeners.erase(it);
+      break;
+    }
+  }
+
+  return this->listeners.size();
+}
+
+Napi::Object Subscription::Stats(Napi::Env env) const {
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("received",
+          double(this->received.load(std::memory_order_relaxed)));
+  obj.Set("delivered",
+          double(this->delivered.load(std::memory_order_relaxed)));
+  if (this->decoder) {
+    // Queued and capacity are in decoded rows
+    std::lock_guard<std::mutex> lock(this->columnsMutex);
+    obj.Set("dropped",
+            double(this->decodeDropped.load(std::memory_order_relaxed)));
+    obj.Set("queued", double(this->columns.rows));
+    obj.Set("capacity", double(this->options.capacity));
+    return obj;
+  }
+  if (this->shared) {
+    // Queued and capacity are in bytes of the shared ring
+    obj.Set("dropped", double(this->shared->Dropped()));
+    obj.Set("queued", double(this->shared->Used()));
+    obj.Set("capacity", double(this->shared->Capacity()));
+    return obj;
+  }
+  obj.Set("dropped", double(this->ring.Dropped()));
+  obj.Set("queued", double(this->ring.Size()));
+  obj.Set("capacity", double(this->ring.Capacity()));
+  return obj;
+}
+
+void Subscription::Schedule() {
+  if (this->scheduled.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  this->scheduledAt.store(Metrics::Now(), std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->closed) {
+    this->drainFn.NonBlockingCall();
+  }
+}
+
+void Subscription::Flush() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  while (!this->closed) {
+    this->wake.wait_for(lock, std::chrono::milliseconds(this->options.interval));
+    if (!this->closed && Pending() > 0 &&
+        !this->scheduled.exchange(true, std::memory_order_acq_rel)) {
+      this->scheduledAt.store(Metrics::Now(), std::memory_order_relaxed);
+      this->drainFn.NonBlockingCall();
+    }
+  }
+}
+
+size_t Subscription::Pending() {
+  if (this->decoder) {
+    std::lock_guard<std::mutex> lock(this->columnsMutex);
+    return this->columns.rows;
+  }
+  return this->ring.Size();
+}
+
+void Subscription::DrainDecoded(Napi::Env env, Napi::Function jsCallback) {
+  // Allocated here rather than on the SimpleBLE thread
+  auto columns = this->decoder->Allocate(this->options.capacity);
+  {
+    std::lock_guard<std::mutex> lock(this->columnsMutex);
+    std::swap(columns, this->columns);
+  }
+
+  this->delivered.fetch_add(columns.payloads, std::memory_order_relaxed);
+  this->metrics->Delivered(columns.payloads);
+  if (columns.rows == 0) {
+    return;
+  }
+
+  jsCallback.Call({this->decoder->ToJS(env, std::move(columns))});
+}
+
+void Subscription::Drain(Napi::Env env, Napi::Function jsCallback,
+                         Subscription *subscription, std::nullptr_t *) {
+  // Cleared first so a payload pushed while draining schedules again
+  subscription->scheduled.store(false, std::memory_order_release);
+
+  bool closed;
+  {
+    std::lock_guard<std::mutex> lock(subscription->mutex);
+    closed = subscription->closed;
+  }
+
+  if (env == nullptr || closed) {
+    return;
+  }
+
+  subscription->metrics->Dispatched(
+      subscription->scheduledAt.load(std::memory_order_relaxed));
+
+  if (subscription->decoder) {
+    subscription->DrainDecoded(env, jsCallback);
+    return;
+  }
+
+  if (subscription->shared) {
+    // Atomics.notify(ring, 0), waking every consumer waiting on the head
+    jsCallback.Call({subscription->sharedArray.Value(),
+                     Napi::Number::New(env, 0)});
+    return;
+  }
+
+  subscription->metrics->Queued(subscription->ring.Size());
+
+  // Hand every payload to JS before calling out, so a throwing callback
+  // can't strand the rest of the batch
+  std::vector<double> timestamps;
+  std::vector<Napi::Uint8Array> values;
+  // Bounded, so a producer outpacing JS can't keep the loop here forever
+  for (size_t i = subscription->ring.Capacity(); i > 0; i--) {
+    Payload *payload = subscription->ring.Pop();
+    if (payload == nullptr) {
+      break;
+    }
+    timestamps.push_back(payload->timestamp);
+    values.push_back(payload->Release(env));
+  }
+
+  if (subscription->ring.Size() > 0) {
+    subscription->Schedule();
+  }
+
+  if (values.empty()) {
+    return;
+  }
+  subscription->delivered.fetch_add(values.size(), std::memory_order_relaxed);
+  subscription->metrics->Delivered(values.size());
+
+  // Copied, a subscriber may unsubscribe another while being called
+  std::vector<Napi::Function> listeners;
+  for (const auto &listener : subscription->listeners) {
+    listeners.push_back(listener.Value());
+  }
+
+  if (!subscription->options.batched) {
+    for (auto &value : values) {
+      for (auto &listener : listeners) {
+        listener.Call({value});
+      }
+    }
+    return;
+  }
+
+  Napi::Array batch = Napi::Array::New(env, values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("timestamp", timestamps[i]);
+    obj.Set("data", values[i]);
+    batch[i] = obj;
+  }
+  for (auto &listener : listeners) {
+    listener.Call({batch});
+  }
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "buffer.h"
+#include "metrics.h"
+#include "payload_decoder.h"
+#include "ring_buffer.h"
+#include "shared_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <thread>
+#include <vector>
+
+// A notify or indicate subscription on a single characteristic. Payloads are
+// pushed from the SimpleBLE thread into a bounded lock-free ring and drained
+// on the JS thread in order. At most one drain is queued on the thread-safe
+// function at a time, so memory and latency stay bounded when JS falls behind
+// and the overflow policy decides what is lost.
+//
+// By default every payload is passed to the callback on its own. In batched
+// mode payloads are accumulated and flushed as one array of
+// { timestamp, data } entries once `count` have arrived or `interval`
+// milliseconds have passed, whichever comes first, so a high rate stream
+// costs one event loop wakeup per batch rather than per packet.
+//
+// In decoded mode batches are columns rather than payloads: each payload is
+// decoded on the SimpleBLE thread by a PayloadDecoder straight into column
+// buffers preallocated for `capacity` rows, which are handed to JS whole. A
+// payload that would take the pending rows past capacity is dropped.
+//
+// In shared mode payloads are written by the SimpleBLE thread straight into a
+// SharedRing over memory owned by JS, for a worker to consume, and never
+// become JS values. With `wake` set the main thread makes one coalesced
+// Atomics.notify on the ring's head after writes, as a native thread can't
+// wake Atomics.wait itself; without it consumers poll.
+class Subscription {
+public:
+  struct Options {
+    bool batched = false;
+    size_t count = 0;
+    uint32_t interval = 0;
+    size_t capacity = 1024;
+    Overflow overflow = Overflow::DropOldest;
+    // Milliseconds a blocked producer waits for room before dropping
+    uint32_t blockTimeout = 100;
+    bool wake = true;
+  };
+
+  // Must be called from the JS thread.
+  static Subscription *New(Napi::Env env, Napi::Function callback,
+                           const char *name, const Options &options);
+
+  // Must be called from the JS thread, the options must be batched.
+  static Subscription *NewDecoded(Napi::Env env, Napi::Function callback,
+                                  const char *name, const Options &options,
+                                  PayloadDecoder decoder);
+
+  // Must be called from the JS thread. The ring must already be checked with
+  // SharedRing::DataSize and is referenced until the subscription is freed.
+  static Subscription *NewShared(Napi::Env env, Napi::Int32Array ring,
+                                 const char *name, const Options &options);
+
+  // Reads capacity, overflow and blockTimeout from a JS options object,
+  // throwing on invalid values.
+  static bool ParseOptions(Napi::Env env, Napi::Object obj, Options &options);
+
+  // As ParseOptions, also reading count and interval for batched delivery,
+  // at least one of which must be set.
+  static bool ParseBatchOptions(Napi::Env env, Napi::Object obj,
+                                Options &options);
+
+  // Called from the SimpleBLE thread.
+  void Push(const uint8_t *data, size_t length);
+
+  // Must be called from the JS thread. Stops delivery, the subscription is
+  // freed once deliveries already queued have been dropped.
+  void Close();
+
+  Napi::Object Stats(Napi::Env env) const;
+
+  // How payloads are delivered, each characteristic is subscribed in one mode
+  // at a time.
+  enum class Mode { Plain, Batched, Decoded, Shared };
+  Mode GetMode() const {
+    if (this->decoder) {
+      return Mode::Decoded;
+    } else if (this->shared) {
+      return Mode::Shared;
+    }
+    return this->options.batched ? Mode::Batched : Mode::Plain;
+  }
+
+  // Whether a later subscriber of the given kind can share this subscription
+  // rather than replace it. Decoded and shared subscriptions are never shared.
+  bool Joinable(bool batched) const {
+    return GetMode() == (batched ? Mode::Batched : Mode::Plain);
+  }
+
+  // Must be called from the JS thread. Each distinct callback is one
+  // subscriber and is passed every delivery, returns false if the callback is
+  // already subscribed.
+  bool AddListener(Napi::Function callback);
+  // Must be called from the JS thread, returns the subscribers left.
+  size_t RemoveListener(Napi::Function callback);
+
+  // Must be called before the subscription is registered with SimpleBLE.
+  void SetMetrics(std::shared_ptr<Metrics> metrics) {
+    this->metrics = std::move(metrics);
+  }
+
+private:
+  static void Drain(Napi::Env env, Napi::Function jsCallback,
+                    Subscription *subscription, std::nullptr_t *);
+  using DrainFn =
+      Napi::TypedThreadSafeFunction<Subscription, std::nullptr_t, Drain>;
+
+  // A decoder is handed over here rather than set afterwards, the flusher
+  // thread reads it as soon as it starts.
+  explicit Subscription(const Options &options,
+                        std::unique_ptr<PayloadDecoder> payloadDecoder = {});
+
+  // Creates the thread-safe function and starts the flusher, every member the
+  // flusher reads must already be set.
+  static Subscription *Start(Napi::Env env, Napi::Function callback,
+                             const char *name, Subscription *subscription);
+
+  // Requests a drain unless one is already pending.
+  void Schedule();
+  void Flush();
+  // Payloads or decoded rows waiting for the next drain.
+  size_t Pending();
+  void DrainDecoded(Napi::Env env, Napi::Function jsCallback);
+
+  Options options;
+  DrainFn drainFn;
+  // Subscribers, starting with the thread-safe function's own callback
+  std::vector<Napi::FunctionReference> listeners;
+  RingBuffer<Payload> ring;
+  // Decoded mode, columns are swapped out whole by the drain
+  std::unique_ptr<PayloadDecoder> decoder;
+  mutable std::mutex columnsMutex;
+  PayloadDecoder::Columns columns;
+  std::atomic<uint64_t> decodeDropped{0};
+  // Shared mode, the ring and the JS array keeping its memory alive
+  std::unique_ptr<SharedRing> shared;
+  Napi::ObjectReference sharedArray;
+  std::atomic<bool> scheduled{false};
+  std::atomic<uint64_t> received{0};
+  std::atomic<uint64_t> delivered{0};
+  std::shared_ptr<Metrics> metrics;
+  // When the pending drain was requested, for dispatch latency
+  std::atomic<uint64_t> scheduledAt{0};
+
+  // Guards drainFn against release while a producer is scheduling, taken
+  // once per wakeup rather than per payload
+  std::mutex mutex;
+  bool closed = false;
+
+  // Interval flushing for batched subscriptions
+  std::thread flusher;
+  std::condition_variable wake;
+};
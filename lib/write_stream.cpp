@@ -0,0 +1,119 @@
+#include "write_stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+// Bytes of each ATT write taken by the opcode and handle
+static constexpr size_t ATT_HEADER_SIZE = 3;
+// The payload every connection supports, the default MTU less the header
+static constexpr size_t MIN_CHUNK_SIZE = 20;
+
+static bool GetCount(Napi::Env env, Napi::Object obj, const char *name,
+                     int64_t min, int64_t &value) {
+  const Napi::Value item = obj.Get(name);
+  if (!item.IsNumber()) {
+    return false;
+  }
+
+  value = item.As<Napi::Number>().Int64Value();
+  if (value < min) {
+    Napi::RangeError::New(env, std::string(name) + " must be at least " +
+                                   std::to_string(min))
+        .ThrowAsJavaScriptException();
+  }
+  return true;
+}
+
+bool WriteStream::ParseOptions(Napi::Env env, Napi::Object obj,
+                               Options &options) {
+  int64_t value;
+  if (GetCount(env, obj, "chunkSize", 1, value)) {
+    options.chunkSize = size_t(value);
+  }
+  if (GetCount(env, obj, "burst", 1, value)) {
+    options.burst = uint32_t(value);
+  }
+  if (GetCount(env, obj, "interval", 0, value)) {
+    options.interval = uint32_t(value);
+  }
+  if (GetCount(env, obj, "retries", 0, value)) {
+    options.retries = uint32_t(value);
+  }
+
+  return !env.IsExceptionPending();
+}
+
+WriteStream::WriteStream(Napi::Env env, simpleble_peripheral_t handle,
+                         simpleble_uuid_t service,
+                         simpleble_uuid_t characteristic,
+                         std::vector<uint8_t> data, const Options &options,
+                         Napi::Function progress)
+    : handle(handle), service(service), characteristic(characteristic),
+      data(std::move(data)), options(options) {
+  if (!progress.IsEmpty()) {
+    this->progressFn =
+        Napi::ThreadSafeFunction::New(env, progress, "onWriteProgress", 0, 1);
+  }
+}
+
+WriteStream::~WriteStream() {
+  if (this->progressFn) {
+    this->progressFn.Release();
+  }
+}
+
+simpleble_err_t WriteStream::Run() {
+  size_t chunkSize = this->options.chunkSize;
+  if (chunkSize == 0) {
+    const size_t mtu = simpleble_peripheral_mtu(this->handle);
+    chunkSize = std::max(mtu > ATT_HEADER_SIZE ? mtu - ATT_HEADER_SIZE : 0,
+                         MIN_CHUNK_SIZE);
+  }
+
+  const auto pause = std::chrono::milliseconds(this->options.interval);
+  size_t offset = 0;
+  uint32_t chunks = 0;
+
+  while (offset < this->data.size()) {
+    const size_t length = std::min(chunkSize, this->data.size() - offset);
+
+    // A refused command usually means the TX queue is full, give it time
+    simpleble_err_t ret;
+    uint32_t attempts = 0;
+    while ((ret = simpleble_peripheral_write_command(
+                this->handle, this->service, this->characteristic,
+                this->data.data() + offset, length)) != SIMPLEBLE_SUCCESS &&
+           attempts++ < this->options.retries) {
+      std::this_thread::sleep_for(pause);
+    }
+
+    if (ret != SIMPLEBLE_SUCCESS) {
+      Report(offset);
+      return ret;
+    }
+    offset += length;
+
+    if (++chunks % this->options.burst == 0 && offset < this->data.size()) {
+      Report(offset);
+      std::this_thread::sleep_for(pause);
+    }
+  }
+
+  Report(offset);
+  return SIMPLEBLE_SUCCESS;
+}
+
+void WriteStream::Report(size_t written) {
+  if (!this->progressFn) {
+    return;
+  }
+
+  const double total = double(this->data.size());
+  this->progressFn.NonBlockingCall(
+      [written, total](Napi::Env env, Napi::Function jsCallback) {
+        jsCallback.Call({Napi::Number::New(env, double(written)),
+                         Napi::Number::New(env, total)});
+      });
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+#include <simpleble_c/peripheral.h>
+#include <vector>
+
+// A large payload written as commands, split into chunks that fit the
+// connection's MTU and sent from the GATT queue thread, so a transfer costs
+// one call from JS. Chunks go out in bursts with a pause in between so the
+// controller's TX queue isn't overrun, and a chunk the stack refuses is
+// retried after a pause before the stream fails. Progress is reported to JS
+// after every burst and once at the end.
+class WriteStream {
+public:
+  struct Options {
+    // Bytes per chunk, 0 to use the MTU less the ATT header
+    size_t chunkSize = 0;
+    uint32_t burst = 8;
+    // Milliseconds between bursts and between retries
+    uint32_t interval = 15;
+    uint32_t retries = 3;
+  };
+
+  // Reads the options from a JS object, throwing on invalid values.
+  static bool ParseOptions(Napi::Env env, Napi::Object obj, Options &options);
+
+  // Must be called from the JS thread, progress may be empty.
+  WriteStream(Napi::Env env, simpleble_peripheral_t handle,
+              simpleble_uuid_t service, simpleble_uuid_t characteristic,
+              std::vector<uint8_t> data, const Options &options,
+              Napi::Function progress);
+  ~WriteStream();
+
+  // Sends every chunk, blocking the calling thread until done or failed.
+  simpleble_err_t Run();
+
+private:
+  void Report(size_t written);
+
+  simpleble_peripheral_t handle;
+  simpleble_uuid_t service;
+  simpleble_uuid_t characteristic;
+  std::vector<uint8_t> data;
+  Options options;
+  Napi::ThreadSafeFunction progressFn;
+};
@@ -23,6 +23,8 @@
 * SOFTWARE.
 */
 
+import type { ConnectionPoolOptions } from './connection-pool';
+
 export interface BluetoothDeviceInit {
     id: string;
     name: string;
@@ -56,6 +58,8 @@ export interface Adapter extends EventTarget {
     getEnabled: () => Promise<boolean>;
     getAdapters: () => Array<{ index: number, address: string, active: boolean }>;
     useAdapter: (index: number) => void;
+    useNotificationBatching: (options?: { count?: number, interval?: number }) => void;
+    useConnectionPool: (options?: ConnectionPoolOptions) => void;
     startScan: (serviceUUIDs: Array<string>, foundFn: (device: BluetoothDeviceInit) => void) => Promise<void>;
     stopScan: () => void;
     connect: (handle: string, disconnectFn?: () => void) => Promise<void>;
@@ -67,7 +71,7 @@ export interface Adapter extends EventTarget {
     readCharacteristic: (handle: string) => Promise<DataView>;
     writeCharacteristic: (handle: string, value: DataView, withoutResponse: boolean) => Promise<void>;
     enableNotify: (handle: string, notifyFn: (value: DataView) => void) => Promise<void>;
-    disableNotify: (handle: string) => Promise<void>;
+    disableNotify: (handle: string, notifyFn: (value: DataView) => void) => Promise<void>;
     readDescriptor: (handle: string) => Promise<DataView>;
     writeDescriptor: (handle: string, value: DataView) => Promise<void>;
 }
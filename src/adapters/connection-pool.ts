@@ -0,0 +1,283 @@
+/*
+* Node Web Bluetooth
+* Copyright (c) 2026 Rob Moran
+*
+* The MIT License (MIT)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+import { Peripheral } from './simpleble';
+
+/**
+ * Options for keeping connections open between uses.
+ * @hidden
+ */
+export interface ConnectionPoolOptions {
+    /** Most released links kept connected, the least recently used is closed first (default 4) */
+    size?: number;
+    /** Milliseconds a released link is kept connected (default 30000) */
+    idleTimeout?: number;
+    /** Reconnect after an unexpected disconnect (default true) */
+    reconnect?: boolean;
+    /** First reconnect delay in milliseconds, doubled on every attempt (default 250) */
+    reconnectDelay?: number;
+    /** Longest reconnect delay in milliseconds (default 10000) */
+    maxReconnectDelay?: number;
+    /** Reconnect attempts before the link is given up, 0 to keep trying (default 5) */
+    reconnectAttempts?: number;
+}
+
+// Pool timers shouldn't keep the process alive
+const unref = (timer: ReturnType<typeof setTimeout>): void => {
+    if (typeof timer === 'object' && 'unref' in timer) {
+        timer.unref();
+    }
+};
+
+interface Link {
+    users: number;
+    connecting?: Promise<void>;
+    idleTimer?: ReturnType<typeof setTimeout>;
+    reconnectTimer?: ReturnType<typeof setTimeout>;
+    attempts: number;
+    closing: boolean;
+    // Restores a subscription after a reconnect, keyed by the caller
+    resubscribers: Map<string, () => boolean>;
+    // One per user that asked to be told
+    onLost: Set<() => void>;
+}
+
+/**
+ * Keeps peripherals connected after they are released so the next acquire skips connection setup.
+ * Links lost unexpectedly are reconnected with exponential backoff and their subscriptions restored,
+ * users are only told once the link is given up.
+ * @hidden
+ */
+export class ConnectionPool {
+    private links = new Map<Peripheral, Link>();
+    // Released links, least recently used first
+    private idle: Peripheral[] = [];
+
+    private size: number;
+    private idleTimeout: number;
+    private reconnect: boolean;
+    private reconnectDelay: number;
+    private maxReconnectDelay: number;
+    private reconnectAttempts: number;
+
+    public constructor(options: ConnectionPoolOptions = {}, private onClosed?: (peripheral: Peripheral) => void) {
+        this.size = options.size ?? 4;
+        this.idleTimeout = options.idleTimeout ?? 30000;
+        this.reconnect = options.reconnect ?? true;
+        this.reconnectDelay = options.reconnectDelay ?? 250;
+        this.maxReconnectDelay = options.maxReconnectDelay ?? 10000;
+        this.reconnectAttempts = options.reconnectAttempts ?? 5;
+    }
+
+    public has(peripheral: Peripheral): boolean {
+        return this.links.has(peripheral);
+    }
+
+    /**
+     * Connects the peripheral, or reuses its open link. `onLost` is called if the link is lost for good while acquired.
+     */
+    public async acquire(peripheral: Peripheral, onLost?: () => void): Promise<void> {
+        let link = this.links.get(peripheral);
+        if (!link) {
+            link = { users: 0, attempts: 0, closing: false, resubscribers: new Map(), onLost: new Set() };
+            this.links.set(peripheral, link);
+            peripheral.setCallbackOnDisconnected(() => this.disconnected(peripheral));
+        }
+
+        this.clearIdle(peripheral, link);
+        link.users++;
+        if (onLost) {
+            link.onLost.add(onLost);
+        }
+
+        // A reconnect waiting out its backoff is brought forward rather than raced
+        if (link.reconnectTimer) {
+            clearTimeout(link.reconnectTimer);
+            link.reconnectTimer = undefined;
+        }
+
+        try {
+            if (link.connecting || !peripheral.connected) {
+                await this.connect(peripheral, link);
+            }
+        } catch (error) {
+            link.users--;
+            if (onLost) {
+                link.onLost.delete(onLost);
+            }
+            // Other users may still hold the link, a lost one keeps reconnecting for them
+            if (link.users === 0) {
+                this.close(peripheral);
+            } else if (link.attempts > 0 && !link.closing && !link.reconnectTimer) {
+                this.scheduleReconnect(peripheral, link);
+            }
+            throw error;
+        }
+    }
+
+    /**
+     * Hands the link back, it stays connected until the idle timeout or until the pool is full.
+     * `onLost` is the callback given to `acquire`, the releasing user is no longer told of a loss.
+     */
+    public release(peripheral: Peripheral, onLost?: () => void): void {
+        const link = this.links.get(peripheral);
+        if (!link || link.users === 0) {
+            return;
+        }
+
+        if (onLost) {
+            link.onLost.delete(onLost);
+        }
+        if (--link.users > 0) {
+            return;
+        }
+
+        link.onLost.clear();
+        link.resubscribers.clear();
+        this.idle.push(peripheral);
+        link.idleTimer = setTimeout(() => this.close(peripheral), this.idleTimeout);
+        unref(link.idleTimer);
+
+        while (this.idle.length > this.size) {
+            this.close(this.idle[0]);
+        }
+    }
+
+    /**
+     * Disconnects the peripheral whether or not it is in use.
+     */
+    public close(peripheral: Peripheral): void {
+        const link = this.links.get(peripheral);
+        if (!link) {
+            return;
+        }
+
+        link.closing = true;
+        this.clearIdle(peripheral, link);
+        if (link.reconnectTimer) {
+            clearTimeout(link.reconnectTimer);
+        }
+        this.links.delete(peripheral);
+
+        if (peripheral.connected) {
+            peripheral.disconnectAsync().catch(() => undefined);
+        }
+        if (this.onClosed) {
+            this.onClosed(peripheral);
+        }
+    }
+
+    /**
+     * Registers a subscription to restore after a reconnect, returning false to drop it.
+     */
+    public track(peripheral: Peripheral, key: string, resubscribe: () => boolean): void {
+        const link = this.links.get(peripheral);
+        if (link) {
+            link.resubscribers.set(key, resubscribe);
+        }
+    }
+
+    public untrack(peripheral: Peripheral, key: string): void {
+        const link = this.links.get(peripheral);
+        if (link) {
+            link.resubscribers.delete(key);
+        }
+    }
+
+    private clearIdle(peripheral: Peripheral, link: Link): void {
+        if (link.idleTimer) {
+            clearTimeout(link.idleTimer);
+            link.idleTimer = undefined;
+        }
+
+        const index = this.idle.indexOf(peripheral);
+        if (index >= 0) {
+            this.idle.splice(index, 1);
+        }
+    }
+
+    private disconnected(peripheral: Peripheral): void {
+        const link = this.links.get(peripheral);
+        if (!link || link.closing || link.connecting || link.reconnectTimer) {
+            return;
+        }
+
+        // Idle links aren't worth reconnecting, the next acquire connects again
+        if (!this.reconnect || link.users === 0) {
+            this.lost(peripheral, link);
+            return;
+        }
+
+        this.scheduleReconnect(peripheral, link);
+    }
+
+    // Every caller shares one attempt, a link restored after a loss gets its subscriptions back
+    private connect(peripheral: Peripheral, link: Link): Promise<void> {
+        if (!link.connecting) {
+            // Subscriptions are only tracked while in use, so any left were on a lost link
+            const restoring = link.resubscribers.size > 0;
+            link.connecting = peripheral.connectAsync().then(() => {
+                link.attempts = 0;
+                if (restoring) {
+                    for (const [key, resubscribe] of link.resubscribers) {
+                        if (!resubscribe()) {
+                            link.resubscribers.delete(key);
+                        }
+                    }
+                }
+            }).finally(() => {
+                link.connecting = undefined;
+            });
+        }
+        return link.connecting;
+    }
+
+    private scheduleReconnect(peripheral: Peripheral, link: Link): void {
+        if (this.reconnectAttempts > 0 && link.attempts >= this.reconnectAttempts) {
+            this.lost(peripheral, link);
+            return;
+        }
+
+        const delay = Math.min(this.reconnectDelay * 2 ** link.attempts, this.maxReconnectDelay);
+        link.attempts++;
+        link.reconnectTimer = setTimeout(() => {
+            link.reconnectTimer = undefined;
+            this.connect(peripheral, link).catch(() => {
+                if (!link.closing) {
+                    this.scheduleReconnect(peripheral, link);
+                }
+            });
+        }, delay);
+        unref(link.reconnectTimer);
+    }
+
+    private lost(peripheral: Peripheral, link: Link): void {
+        const onLost = [...link.onLost];
+        this.close(peripheral);
+        for (const fn of onLost) {
+            fn();
+        }
+    }
+}
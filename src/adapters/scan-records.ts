@@ -0,0 +1,174 @@
+/*
+* Node Web Bluetooth
+* Copyright (c) 2026 Rob Moran
+*
+* The MIT License (MIT)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+import { AddressType } from './simpleble';
+
+// Must match lib/scan_records.h
+const VERSION = 1;
+const HEADER_SIZE = 8;
+const RECORD_SIZE = 20;
+const UUID_LENGTH = 36;
+
+/**
+ * @hidden
+ */
+export interface ScanRecordService {
+    uuid: string;
+    data: Uint8Array;
+}
+
+/**
+ * A single packed scan result, fields are decoded on first access.
+ * @hidden
+ */
+export class ScanRecord {
+    private payloadOffset: number;
+    private _identifier: string | undefined;
+    private _address: string | undefined;
+    private _services: ScanRecordService[] | undefined;
+    private _manufacturerData: Map<number, Uint8Array> | undefined;
+
+    public constructor(private buffer: ArrayBuffer, private view: DataView, private offset: number) {
+        this.payloadOffset = view.getUint32(offset + 8, true);
+    }
+
+    public get rssi(): number {
+        return this.view.getInt16(this.offset, true);
+    }
+
+    public get txPower(): number {
+        return this.view.getInt16(this.offset + 2, true);
+    }
+
+    public get addressType(): AddressType {
+        return this.view.getUint8(this.offset + 4);
+    }
+
+    public get connectable(): boolean {
+        return (this.view.getUint8(this.offset + 5) & 1) !== 0;
+    }
+
+    public get paired(): boolean {
+        return (this.view.getUint8(this.offset + 5) & 2) !== 0;
+    }
+
+    public get identifier(): string {
+        if (this._identifier === undefined) {
+            this._identifier = this.text(this.payloadOffset, this.identifierLength);
+        }
+        return this._identifier;
+    }
+
+    public get address(): string {
+        if (this._address === undefined) {
+            this._address = this.text(this.payloadOffset + this.identifierLength, this.addressLength);
+        }
+        return this._address;
+    }
+
+    public get services(): ScanRecordService[] {
+        if (!this._services) {
+            this.decodeData();
+        }
+        return this._services || [];
+    }
+
+    public get manufacturerData(): Map<number, Uint8Array> {
+        if (!this._manufacturerData) {
+            this.decodeData();
+        }
+        return this._manufacturerData || new Map();
+    }
+
+    private get identifierLength(): number {
+        return this.view.getUint16(this.offset + 12, true);
+    }
+
+    private get addressLength(): number {
+        return this.view.getUint16(this.offset + 14, true);
+    }
+
+    private text(offset: number, length: number): string {
+        return Buffer.from(this.buffer, offset, length).toString('utf8');
+    }
+
+    private decodeData(): void {
+        let position = this.payloadOffset + this.identifierLength + this.addressLength;
+
+        const services: ScanRecordService[] = [];
+        const serviceCount = this.view.getUint8(this.offset + 6);
+        for (let i = 0; i < serviceCount; i++) {
+            const uuid = this.text(position, UUID_LENGTH);
+            const length = this.view.getUint8(position + UUID_LENGTH);
+            position += UUID_LENGTH + 1;
+            services.push({ uuid, data: new Uint8Array(this.buffer, position, length) });
+            position += length;
+        }
+
+        const manufacturerData = new Map<number, Uint8Array>();
+        const manufacturerCount = this.view.getUint8(this.offset + 7);
+        for (let i = 0; i < manufacturerCount; i++) {
+            const id = this.view.getUint16(position, true);
+            const length = this.view.getUint8(position + 2);
+            position += 3;
+            manufacturerData.set(id, new Uint8Array(this.buffer, position, length));
+            position += length;
+        }
+
+        this._services = services;
+        this._manufacturerData = manufacturerData;
+    }
+}
+
+/**
+ * Lazy view over the buffer returned by `Adapter.scanResults()`, records are only decoded when accessed.
+ * @hidden
+ */
+export class ScanRecords implements Iterable<ScanRecord> {
+    public readonly length: number;
+    private view: DataView;
+
+    public constructor(private buffer: ArrayBuffer) {
+        this.view = new DataView(buffer);
+        const version = this.view.getUint32(0, true);
+        if (version !== VERSION) {
+            throw new Error(`Unsupported scan record version ${version}`);
+        }
+        this.length = this.view.getUint32(4, true);
+    }
+
+    public get(index: number): ScanRecord {
+        if (index < 0 || index >= this.length) {
+            throw new RangeError('Scan record index out of range');
+        }
+        return new ScanRecord(this.buffer, this.view, HEADER_SIZE + index * RECORD_SIZE);
+    }
+
+    public *[Symbol.iterator](): Iterator<ScanRecord> {
+        for (let i = 0; i < this.length; i++) {
+            yield this.get(i);
+        }
+    }
+}
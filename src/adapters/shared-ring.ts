@@ -0,0 +1,147 @@
+/*
+* Node Web Bluetooth
+* Copyright (c) 2026 Rob Moran
+*
+* The MIT License (MIT)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+// Must match lib/shared_ring.h
+const VERSION = 1;
+const HEADER_SIZE = 64;
+const RECORD_HEADER_SIZE = 16;
+const MIN_DATA_SIZE = 64;
+const MAX_DATA_SIZE = 2 ** 31;
+const WRAP = 0xffffffff;
+const HEAD = 0;
+const TAIL = 1;
+const DROPPED = 2;
+const VERSION_SLOT = 3;
+
+const dataSize = (byteLength: number): number => {
+    let size = MIN_DATA_SIZE;
+    while (size < MAX_DATA_SIZE && size * 2 <= byteLength - HEADER_SIZE) {
+        size *= 2;
+    }
+    return size;
+};
+
+/**
+ * Creates a ring for `peripheral.notifyShared()` holding at least `size` bytes of records,
+ * each record takes 16 bytes plus its payload rounded up to 8 bytes.
+ * @hidden
+ */
+export const createSharedRing = (size: number): Int32Array => {
+    let data = MIN_DATA_SIZE;
+    while (data < size && data < MAX_DATA_SIZE) {
+        data *= 2;
+    }
+    return new Int32Array(new SharedArrayBuffer(HEADER_SIZE + data));
+};
+
+/**
+ * A notification read from a shared ring.
+ * @hidden
+ */
+export interface SharedRingRecord {
+    /** Time of receipt in milliseconds since the epoch */
+    timestamp: number;
+    data: Uint8Array;
+}
+
+/**
+ * Consumes a ring filled by `peripheral.notifyShared()`, normally from a worker thread
+ * the ring was posted to. There must be only one reader per ring.
+ * @hidden
+ */
+export class SharedRingReader {
+    private view: DataView;
+    private bytes: Uint8Array;
+    private mask: number;
+
+    public constructor(private ring: Int32Array) {
+        if (ring.byteLength < HEADER_SIZE + MIN_DATA_SIZE) {
+            throw new RangeError('Ring is too small');
+        }
+        const version = Atomics.load(ring, VERSION_SLOT);
+        if (version !== 0 && version !== VERSION) {
+            throw new Error(`Unsupported shared ring version ${version}`);
+        }
+
+        const data = dataSize(ring.byteLength);
+        this.view = new DataView(ring.buffer, ring.byteOffset + HEADER_SIZE, data);
+        this.bytes = new Uint8Array(ring.buffer, ring.byteOffset + HEADER_SIZE, data);
+        this.mask = data - 1;
+    }
+
+    /**
+     * Notifications dropped because the ring was full
+     */
+    public get dropped(): number {
+        return Atomics.load(this.ring, DROPPED) >>> 0;
+    }
+
+    /**
+     * Bytes written and not yet read
+     */
+    public get used(): number {
+        return (Atomics.load(this.ring, HEAD) - Atomics.load(this.ring, TAIL)) >>> 0;
+    }
+
+    /**
+     * Takes the oldest record, the payload is copied so its space can be reused at once
+     */
+    public read(): SharedRingRecord | undefined {
+        const head = Atomics.load(this.ring, HEAD) >>> 0;
+        let tail = Atomics.load(this.ring, TAIL) >>> 0;
+        if (head === tail) {
+            return undefined;
+        }
+
+        let position = tail & this.mask;
+        let length = this.view.getUint32(position, true);
+        if (length === WRAP) {
+            tail += this.mask + 1 - position;
+            position = 0;
+            length = this.view.getUint32(0, true);
+        }
+
+        const timestamp = this.view.getFloat64(position + 8, true);
+        const start = position + RECORD_HEADER_SIZE;
+        const data = this.bytes.slice(start, start + length);
+
+        const size = (RECORD_HEADER_SIZE + length + 7) & ~7;
+        Atomics.store(this.ring, TAIL, (tail + size) | 0);
+        return { timestamp, data };
+    }
+
+    /**
+     * Blocks until a record is available or `timeout` milliseconds pass, returning whether one is.
+     * Woken by the subscription's `wake` option, otherwise only by the timeout.
+     */
+    public wait(timeout = Infinity): boolean {
+        const tail = Atomics.load(this.ring, TAIL);
+        if (Atomics.load(this.ring, HEAD) !== tail) {
+            return true;
+        }
+        Atomics.wait(this.ring, HEAD, tail, timeout);
+        return Atomics.load(this.ring, HEAD) !== tail;
+    }
+}
@@ -25,14 +25,19 @@
 
 import { Adapter as BluetoothAdapter, BluetoothDeviceInit, BluetoothRemoteGATTServiceInit, BluetoothRemoteGATTCharacteristicInit, BluetoothRemoteGATTDescriptorInit } from './adapter';
 import { BluetoothUUID } from '../uuid';
+import { ConnectionPool, ConnectionPoolOptions } from './connection-pool';
 import {
     isEnabled,
     getAdapters as simpleBleAdapters,
     Adapter,
+    Attribute,
+    BatchEntry,
+    BatchOptions,
     Peripheral,
     Service,
     Characteristic,
-    Descriptor
+    Descriptor,
+    SubscriptionListener
 } from './simpleble';
 
 /**
@@ -48,19 +53,23 @@ class PeripheralHandles {
     private services = new Map<string, Service>();
     private characteristics = new Map<string, Characteristic>();
     private descriptors = new Map<string, Descriptor>();
+    private attributes = new Map<string, Attribute>();
 
     public constructor(private peripherals: Map<string, Peripheral>) {
     }
 
-    public characteristicEvents = new Map<string, (value: DataView) => void>();
+    // Each subscriber's native listener, one per notifyFn
+    public notifyListeners = new Map<string, Map<(value: DataView) => void, SubscriptionListener>>();
 
     public createHandles(peripheral: Peripheral): void {
+        const all: string[] = [];
         const services: string[] = [];
         for (const service of peripheral.services) {
             const serviceHandle = `${this.handleCounter++}`;
             this.parents.set(serviceHandle, peripheral.address);
             this.services.set(serviceHandle, service);
             services.push(serviceHandle);
+            all.push(serviceHandle);
 
             const characteristics: string[] = [];
             for (const characteristic of service.characteristics) {
@@ -68,6 +77,7 @@ class PeripheralHandles {
                 this.parents.set(characteristicHandle, serviceHandle);
                 this.characteristics.set(characteristicHandle, characteristic);
                 characteristics.push(characteristicHandle);
+                all.push(characteristicHandle);
 
                 const descriptors: string[] = [];
                 for (const descriptor of characteristic.descriptors) {
@@ -75,6 +85,7 @@ class PeripheralHandles {
                     this.parents.set(descHandle, characteristicHandle);
                     this.descriptors.set(descHandle, descriptor);
                     descriptors.push(descHandle);
+                    all.push(descHandle);
                 }
                 this.children.set(characteristicHandle, descriptors);
             }
@@ -82,21 +93,28 @@ class PeripheralHandles {
         }
 
         this.children.set(peripheral.address, services);
+        this.peripheralChildren.set(peripheral, all);
     }
 
     public deleteHandles(peripheral: Peripheral): void {
         const children = this.peripheralChildren.get(peripheral);
         if (children) {
             for (const child of children) {
+                // The link may be kept open, stop delivering to this session
+                if (this.notifyListeners.get(child)?.size) {
+                    this.attributes.get(child)?.unsubscribe();
+                }
                 this.children.delete(child);
                 this.parents.delete(child);
                 this.services.delete(child);
                 this.characteristics.delete(child);
                 this.descriptors.delete(child);
-                this.characteristicEvents.delete(child);
+                this.attributes.delete(child);
+                this.notifyListeners.delete(child);
             }
         }
         this.peripheralChildren.delete(peripheral);
+        this.children.delete(peripheral.address);
     }
 
     public getServices(deviceHandle: string): { [key: string]: Service } {
@@ -166,6 +184,24 @@ class PeripheralHandles {
         return descriptors;
     }
 
+    /**
+     * Resolves a characteristic or descriptor handle to a native attribute once, later operations skip UUID marshalling.
+     */
+    public getAttribute(handle: string): Attribute {
+        let attribute = this.attributes.get(handle);
+        if (!attribute) {
+            if (this.descriptors.has(handle)) {
+                const { peripheral, service, characteristic, descriptor } = this.getDescriptorGraph(handle);
+                attribute = peripheral.attribute(service.uuid, characteristic.uuid, descriptor);
+            } else {
+                const { peripheral, service, characteristic } = this.getCharacteristicGraph(handle);
+                attribute = peripheral.attribute(service.uuid, characteristic.uuid);
+            }
+            this.attributes.set(handle, attribute);
+        }
+        return attribute;
+    }
+
     public getCharacteristicGraph(characteristicHandle: string): { peripheral: Peripheral, service: Service, characteristic: Characteristic } {
         const serviceHandle = this.parents.get(characteristicHandle);
         if (!serviceHandle) {
@@ -248,10 +284,22 @@ class PeripheralHandles {
  * @hidden
  */
 export class SimplebleAdapter extends EventTarget implements BluetoothAdapter {
+    // Set by useAdapter, otherwise every adapter is used
     private adapter: Adapter | undefined;
+    private scanning: Adapter[] = [];
+    private notificationBatch: BatchOptions | undefined;
+    private pool: ConnectionPool | undefined;
     private peripherals = new Map<string, Peripheral>();
     private handles = new PeripheralHandles(this.peripherals);
 
+    // Each adapter that has seen a device holds its own peripheral for it, the
+    // connection goes through the adapter with the fewest live connections
+    private sightings = new Map<string, Array<{ adapter: Adapter, peripheral: Peripheral }>>();
+    private connections = new Map<Adapter, number>();
+    private connectedOn = new Map<string, Adapter>();
+    // Handed back to the pool on disconnect so only this device stops being told of a loss
+    private lostFns = new Map<string, () => void>();
+
     private validDevice(device: BluetoothDeviceInit, serviceUUIDs: Array<string>): boolean {
         if (serviceUUIDs.length === 0) {
             // Match any device
@@ -329,45 +377,125 @@ export class SimplebleAdapter extends EventTarget implements BluetoothAdapter {
         this.adapter = selected;
     }
 
+    public useNotificationBatching(options?: BatchOptions): void {
+        this.notificationBatch = options;
+    }
+
+    public useConnectionPool(options?: ConnectionPoolOptions): void {
+        this.pool = new ConnectionPool(options, peripheral => {
+            for (const [handle, pooled] of this.peripherals) {
+                if (pooled === peripheral) {
+                    this.releaseConnection(handle);
+                }
+            }
+        });
+    }
+
     public async startScan(serviceUUIDs: Array<string>, foundFn: (device: BluetoothDeviceInit) => void): Promise<void> {
         if (this.state === false) {
             throw new Error('adapter not enabled');
         }
 
-        if (!this.adapter) {
-            this.adapter = simpleBleAdapters()[0];
+        const adapters = this.adapter ? [this.adapter] : simpleBleAdapters();
+        if (adapters.length === 0) {
+            throw new Error('no adapters found');
         }
 
-        const foundPeripherals: string[] = [];
-        this.adapter.setCallbackOnScanFound(peripheral => {
-            const device = this.buildBluetoothDevice(peripheral);
-            if (this.validDevice(device, serviceUUIDs)) {
-                if (!foundPeripherals.includes(device.id)) {
-                    foundPeripherals.push(device.id);
-                    this.peripherals.set(device.id, peripheral);
-                    // Only call the found function the first time we find a valid device
-                    foundFn(device);
+        // Results from every adapter are merged, a device is reported once however many adapters see it
+        const foundPeripherals = new Set<string>();
+        for (const adapter of adapters) {
+            // Filter natively so non-matching peripherals never cross into JS
+            adapter.setScanFilter({ services: serviceUUIDs, dedupe: true });
+
+            adapter.setCallbackOnScanFound(peripheral => {
+                const device = this.buildBluetoothDevice(peripheral);
+                if (this.validDevice(device, serviceUUIDs)) {
+                    this.addSighting(device.id, adapter, peripheral);
+                    if (!foundPeripherals.has(device.id)) {
+                        foundPeripherals.add(device.id);
+                        this.peripherals.set(device.id, peripheral);
+                        // Only call the found function the first time we find a valid device
+                        foundFn(device);
+                    }
                 }
+            });
+        }
+
+        for (const adapter of adapters) {
+            if (!adapter.scanStart()) {
+                this.stopScan();
+                throw new Error('scan start failed');
             }
-        });
+            this.scanning.push(adapter);
+        }
+    }
 
-        const success = this.adapter.scanStart();
+    public stopScan(_errorFn?: (errorMsg: string) => void): void {
+        const adapters = this.scanning;
+        this.scanning = [];
+
+        let success = true;
+        for (const adapter of adapters) {
+            success = adapter.scanStop() && success;
+        }
         if (!success) {
-            throw new Error('scan start failed');
+            throw new Error('scan stop failed');
         }
     }
 
-    public stopScan(_errorFn?: (errorMsg: string) => void): void {
-        if (this.adapter) {
-            const success = this.adapter.scanStop();
-            if (!success) {
-                throw new Error('scan stop failed');
+    private addSighting(id: string, adapter: Adapter, peripheral: Peripheral): void {
+        const sightings = this.sightings.get(id) || [];
+        const existing = sightings.find(sighting => sighting.adapter === adapter);
+        if (existing) {
+            existing.peripheral = peripheral;
+        } else {
+            sightings.push({ adapter, peripheral });
+        }
+        this.sightings.set(id, sightings);
+    }
+
+    // The peripheral on the least loaded adapter that has seen the device, ties go to the strongest signal
+    private selectPeripheral(handle: string): { adapter?: Adapter, peripheral?: Peripheral } {
+        const sightings = this.sightings.get(handle);
+        if (!sightings || sightings.length === 0) {
+            return { peripheral: this.peripherals.get(handle) };
+        }
+
+        // An open pooled link wins outright
+        const pooled = sightings.find(sighting => this.pool && this.pool.has(sighting.peripheral));
+        let selected = pooled || sightings[0];
+        if (!pooled) {
+            for (const sighting of sightings.slice(1)) {
+                const load = this.connections.get(sighting.adapter) || 0;
+                const selectedLoad = this.connections.get(selected.adapter) || 0;
+                if (load < selectedLoad || (load === selectedLoad && sighting.peripheral.rssi > selected.peripheral.rssi)) {
+                    selected = sighting;
+                }
             }
         }
+
+        this.peripherals.set(handle, selected.peripheral);
+        return selected;
+    }
+
+    // Counted once the link is up, a link already counted is not counted again
+    private countConnection(handle: string, adapter?: Adapter): void {
+        if (adapter && !this.connectedOn.has(handle)) {
+            this.connectedOn.set(handle, adapter);
+            this.connections.set(adapter, (this.connections.get(adapter) || 0) + 1);
+        }
+    }
+
+    private releaseConnection(handle: string): void {
+        const adapter = this.connectedOn.get(handle);
+        if (adapter) {
+            this.connectedOn.delete(handle);
+            this.connections.set(adapter, (this.connections.get(adapter) || 1) - 1);
+        }
     }
 
     public async connect(handle: string, disconnectFn?: () => void): Promise<void> {
-        const peripheral = this.peripherals.get(handle);
+        const { adapter, peripheral } = this.selectPeripheral(handle);
         if (!peripheral) {
             throw new Error('Peripheral not found');
         }
@@ -376,13 +504,22 @@ export class SimplebleAdapter extends EventTarget implements BluetoothAdapter {
             throw new Error('Connection not possible');
         }
 
-        const success = peripheral.connect();
-        if (!success) {
-            throw new Error('Connect failed');
-        }
+        if (this.pool) {
+            await this.pool.acquire(peripheral, disconnectFn);
+            this.countConnection(handle, adapter);
+            if (disconnectFn) {
+                this.lostFns.set(handle, disconnectFn);
+            }
+        } else {
+            await peripheral.connectAsync();
+            this.countConnection(handle, adapter);
 
-        if (disconnectFn) {
-            peripheral.setCallbackOnDisconnected(() => disconnectFn());
+            peripheral.setCallbackOnDisconnected(() => {
+                this.releaseConnection(handle);
+                if (disconnectFn) {
+                    disconnectFn();
+                }
+            });
         }
 
         this.handles.createHandles(peripheral);
@@ -394,12 +531,17 @@ export class SimplebleAdapter extends EventTarget implements BluetoothAdapter {
             throw new Error('Peripheral not found');
         }
 
-        const success = peripheral.disconnect();
-
-        if (!success) {
-            throw new Error('Disconnect failed');
+        if (this.pool) {
+            // Kept open for the next connect
+            this.handles.deleteHandles(peripheral);
+            this.pool.release(peripheral, this.lostFns.get(handle));
+            this.lostFns.delete(handle);
+            return;
         }
 
+        await peripheral.disconnectAsync();
+
+        this.releaseConnection(handle);
         this.handles.deleteHandles(peripheral);
     }
 
@@ -426,7 +568,7 @@ export class SimplebleAdapter extends EventTarget implements BluetoothAdapter {
     }
 
     public async discoverCharacteristics(handle: string, characteristicUUIDs?: Array<string>): Promise<Array<BluetoothRemoteGATTCharacteristicInit>> {
-        const { peripheral, service, characteristics } = this.handles.getCharacteristics(handle);
+        const { characteristics } = this.handles.getCharacteristics(handle);
 
         const discovered: BluetoothRemoteGATTCharacteristicInit[] = [];
 
@@ -451,28 +593,6 @@ export class SimplebleAdapter extends EventTarget implements BluetoothAdapter {
                         writableAuxiliaries: false // characteristic.capabilities.includes('???'),
                     }
                 });
-
-                if (characteristic.canIndicate) {
-                    peripheral.indicate(service.uuid, charUUID, data => {
-                        if (this.handles.characteristicEvents.has(handle)) {
-                            const event = this.handles.characteristicEvents.get(handle);
-                            if (event) {
-                                event(new DataView(data.buffer));
-                            }
-                        }
-                    });
-                }
-
-                if (characteristic.canNotify) {
-                    peripheral.notify(service.uuid, charUUID, data => {
-                        if (this.handles.characteristicEvents.has(handle)) {
-                            const event = this.handles.characteristicEvents.get(handle);
-                            if (event) {
-                                event(new DataView(data.buffer));
-                            }
-                        }
-                    });
-                }
             }
         }
 
@@ -498,51 +618,117 @@ export class SimplebleAdapter extends EventTarget implements BluetoothAdapter {
     }
 
     public async readCharacteristic(handle: string): Promise<DataView> {
-        const { peripheral, service, characteristic } = this.handles.getCharacteristicGraph(handle);
-        const data = peripheral.read(service.uuid, characteristic.uuid);
+        const data = await this.handles.getAttribute(handle).readAsync();
         return new DataView(data.buffer);
     }
 
     public async writeCharacteristic(handle: string, value: DataView, withoutResponse: boolean): Promise<void> {
-        const { peripheral, service, characteristic } = this.handles.getCharacteristicGraph(handle);
-        let success = false;
+        const attribute = this.handles.getAttribute(handle);
 
         if (withoutResponse) {
-            // Command is 'fire and forget'
-            success = peripheral.writeCommand(service.uuid, characteristic.uuid, new Uint8Array(value.buffer));
+            // Command is 'fire and forget', a round trip through the GATT queue would only add latency
+            if (!attribute.writeCommand(new Uint8Array(value.buffer))) {
+                throw new Error('Write failed');
+            }
         } else {
             // Request includes a response
-            success = peripheral.writeRequest(service.uuid, characteristic.uuid, new Uint8Array(value.buffer));
+            await attribute.writeRequestAsync(new Uint8Array(value.buffer));
         }
+    }
 
-        if (!success) {
-            throw new Error('Write failed');
+    public async enableNotify(handle: string, notifyFn: (value: DataView) => void): Promise<void> {
+        const listeners = this.handles.notifyListeners.get(handle) || new Map();
+        // The same subscriber starting again is not counted twice
+        if (listeners.has(notifyFn)) {
+            return;
+        }
+
+        // Native side shares one subscription, the CCCD is only written by the first subscriber
+        listeners.set(notifyFn, this.subscribe(handle, notifyFn));
+        this.handles.notifyListeners.set(handle, listeners);
+
+        // Restored by the pool if the link drops and reconnects
+        if (this.pool && listeners.size === 1) {
+            const { peripheral } = this.handles.getCharacteristicGraph(handle);
+            this.pool.track(peripheral, handle, () => this.resubscribe(handle));
         }
     }
 
-    public async enableNotify(handle: string, notifyFn: (value: DataView) => void): Promise<void> {
-        this.handles.characteristicEvents.set(handle, notifyFn);
+    public async disableNotify(handle: string, notifyFn: (value: DataView) => void): Promise<void> {
+        const listeners = this.handles.notifyListeners.get(handle);
+        const listener = listeners?.get(notifyFn);
+        if (!listeners || !listener) {
+            return;
+        }
+
+        // Native side only tears down with the last subscriber
+        listeners.delete(notifyFn);
+        this.handles.getAttribute(handle).unsubscribe(listener);
+        if (listeners.size === 0) {
+            this.handles.notifyListeners.delete(handle);
+            if (this.pool) {
+                this.pool.untrack(this.handles.getCharacteristicGraph(handle).peripheral, handle);
+            }
+        }
     }
 
-    public async disableNotify(handle: string): Promise<void> {
-        this.handles.characteristicEvents.delete(handle);
+    private subscribe(handle: string, notifyFn: (value: DataView) => void): SubscriptionListener {
+        const { characteristic } = this.handles.getCharacteristicGraph(handle);
+        const attribute = this.handles.getAttribute(handle);
+
+        const dispatch = (data: Uint8Array) => notifyFn(new DataView(data.buffer));
+
+        let listener: SubscriptionListener;
+        let success: boolean;
+        if (characteristic.canNotify && this.notificationBatch) {
+            // One native wakeup per batch, values are still dispatched individually
+            const batched = (batch: BatchEntry[]) => {
+                for (const entry of batch) {
+                    dispatch(entry.data);
+                }
+            };
+            listener = batched;
+            success = attribute.notifyBatched(this.notificationBatch, batched);
+        } else if (characteristic.canNotify) {
+            listener = dispatch;
+            success = attribute.notify(dispatch);
+        } else if (characteristic.canIndicate) {
+            listener = dispatch;
+            success = attribute.indicate(dispatch);
+        } else {
+            throw new Error('Characteristic does not support notifications');
+        }
+
+        if (!success) {
+            throw new Error('Subscribe failed');
+        }
+        return listener;
     }
 
-    public async readDescriptor(handle: string): Promise<DataView> {
-        const { peripheral, service, characteristic, descriptor } = this.handles.getDescriptorGraph(handle);
-        const data = peripheral.readDescriptor(service.uuid, characteristic.uuid, descriptor);
-        if (!data) {
-            throw new Error('Read failed');
+    private resubscribe(handle: string): boolean {
+        const listeners = this.handles.notifyListeners.get(handle);
+        if (!listeners) {
+            return false;
+        }
+
+        try {
+            // The old subscription went with the link, every subscriber starts a new one
+            this.handles.getAttribute(handle).unsubscribe();
+            for (const notifyFn of listeners.keys()) {
+                listeners.set(notifyFn, this.subscribe(handle, notifyFn));
+            }
+            return true;
+        } catch {
+            return false;
         }
+    }
+
+    public async readDescriptor(handle: string): Promise<DataView> {
+        const data = await this.handles.getAttribute(handle).readAsync();
         return new DataView(data.buffer);
     }
 
     public async writeDescriptor(handle: string, value: DataView): Promise<void> {
-        const { peripheral, service, characteristic, descriptor } = this.handles.getDescriptorGraph(handle);
-        const success = peripheral.writeDescriptor(service.uuid, characteristic.uuid, descriptor, new Uint8Array(value.buffer));
-
-        if (!success) {
-            throw new Error('Write failed');
-        }
+        await this.handles.getAttribute(handle).writeRequestAsync(new Uint8Array(value.buffer));
     }
 }
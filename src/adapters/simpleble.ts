@@ -62,6 +62,115 @@ export interface Service {
     characteristics: Characteristic[];
 }
 
+/** Options for the bounded queue between the SimpleBLE thread and JS. */
+export interface DeliveryOptions {
+    /** Maximum queued events, rounded up to a power of two (default 1024) */
+    capacity?: number;
+    /** What to do when the queue is full (default 'drop-oldest') */
+    overflow?: 'drop-oldest' | 'drop-newest' | 'block';
+    /**
+     * With 'block', milliseconds the SimpleBLE thread waits for room before dropping the event (default 100).
+     * The wait stalls every callback of the adapter, not just this queue
+     */
+    blockTimeout?: number;
+}
+
+/** Delivery counters for a subscription. */
+export interface SubscriptionStats {
+    received: number;
+    delivered: number;
+    dropped: number;
+    queued: number;
+    capacity: number;
+}
+
+/** Options for batched notification delivery. */
+export interface BatchOptions extends DeliveryOptions {
+    /** Flush after this many notifications, at most the capacity */
+    count?: number;
+    /** Flush after this many milliseconds */
+    interval?: number;
+}
+
+/** A notification delivered as part of a batch. */
+export interface BatchEntry {
+    /** Time of receipt in milliseconds since the epoch */
+    timestamp: number;
+    data: Uint8Array;
+}
+
+/**
+ * A callback passed to notify, notifyBatched or indicate, identifying its subscriber. Subscribing a
+ * characteristic already subscribed with another of the notify methods throws a TypeError.
+ */
+export type SubscriptionListener = ((data: Uint8Array) => void) | ((batch: BatchEntry[]) => void);
+
+/** Value types for a decoded payload field, little endian, 24 bit fields widen to 32 bits. */
+export type PayloadFieldType = 'int8' | 'uint8' | 'int16' | 'uint16' | 'int24' | 'uint24' | 'int32' | 'uint32' | 'float32' | 'float64';
+
+/** A field of a fixed payload layout. */
+export interface PayloadField {
+    name: string;
+    type: PayloadFieldType;
+    /** Byte offset within a record (default straight after the previous field) */
+    offset?: number;
+}
+
+/** A fixed payload layout, a payload holds as many records of `stride` bytes as fit. */
+export interface PayloadLayout {
+    fields: PayloadField[];
+    /** Bytes per record (default the end of the last field) */
+    stride?: number;
+}
+
+/** Column types for each field type. */
+export type PayloadColumn = Int8Array | Uint8Array | Int16Array | Uint16Array | Int32Array | Uint32Array | Float32Array | Float64Array;
+
+/** Decoded records delivered as columns, one row per record. */
+export interface DecodedBatch {
+    count: number;
+    /** Time each row's payload was received in milliseconds since the epoch */
+    timestamp: Float64Array;
+    columns: { [name: string]: PayloadColumn };
+}
+
+/** Options for notifications written into a shared ring. */
+export interface SharedNotifyOptions {
+    /** Atomics.notify waiting consumers from the main thread after writes, coalesced (default true) */
+    wake?: boolean;
+}
+
+/** Pacing for a streamed write, chunks are sent as commands. */
+export interface WriteStreamOptions {
+    /** Bytes per chunk (default the MTU less the 3 byte ATT header, at least 20) */
+    chunkSize?: number;
+    /** Chunks sent back to back before pausing (default 8) */
+    burst?: number;
+    /** Milliseconds to pause after each burst and before each retry (default 15) */
+    interval?: number;
+    /** Times a refused chunk is retried before the stream fails (default 3) */
+    retries?: number;
+}
+
+/** Characteristic or descriptor resolved once for repeated operations, descriptors only support reads and write requests. */
+export interface Attribute {
+    service: string;
+    characteristic: string;
+    descriptor?: string;
+
+    read(): Uint8Array;
+    readAsync(): Promise<Uint8Array>;
+    writeRequest(data: Uint8Array): boolean;
+    writeRequestAsync(data: Uint8Array): Promise<void>;
+    writeCommand(data: Uint8Array): boolean;
+    writeCommandAsync(data: Uint8Array): Promise<void>;
+    notify(cb: (data: Uint8Array) => void, options?: DeliveryOptions): boolean;
+    notifyBatched(options: BatchOptions, cb: (batch: BatchEntry[]) => void): boolean;
+    indicate(cb: (data: Uint8Array) => void, options?: DeliveryOptions): boolean;
+    /** Removes the subscriber listening with cb, or every subscriber without it. */
+    unsubscribe(cb?: SubscriptionListener): boolean;
+}
+
 /** SimpleBLE Peripheral. */
 export interface Peripheral {
     identifier: string;
@@ -77,20 +186,62 @@ export interface Peripheral {
     services: Service[];
 
     connect(): boolean;
+    connectAsync(): Promise<void>;
     disconnect(): boolean;
+    disconnectAsync(): Promise<void>;
     unpair(): boolean;
+    /** Drops the cached services tree, rebuilt on the next `services` access. */
+    invalidateServices(): void;
+    servicesCacheStats(): { hits: number, misses: number };
     read(service: string, characteristic: string): Uint8Array;
+    readAsync(service: string, characteristic: string): Promise<Uint8Array>;
     writeRequest(service: string, characteristic: string, data: Uint8Array): boolean;
+    writeRequestAsync(service: string, characteristic: string, data: Uint8Array): Promise<void>;
     writeCommand(service: string, characteristic: string, data: Uint8Array): boolean;
-    notify(service: string, characteristic: string, cb: (data: Uint8Array) => void): boolean;
-    indicate(service: string, characteristic: string, cb: (data: Uint8Array) => void): boolean;
-    unsubscribe(service: string, characteristic: string): boolean;
+    writeCommandAsync(service: string, characteristic: string, data: Uint8Array): Promise<void>;
+    /** Reads every entry back to back off the JS thread, failed reads resolve as an Error in their slot. */
+    readMany(entries: Array<[service: string, characteristic: string]>): Promise<Array<Uint8Array | Error>>;
+    /** Writes every entry back to back off the JS thread as requests, or as commands if set, failed writes resolve as an Error in their slot. */
+    writeMany(entries: Array<[service: string, characteristic: string, data: Uint8Array]>, command?: boolean): Promise<Array<Error | undefined>>;
+    /** Writes a payload larger than the MTU as paced commands off the JS thread, progress is reported after each burst. */
+    writeStream(service: string, characteristic: string, data: Uint8Array, options?: WriteStreamOptions, progress?: (written: number, total: number) => void): Promise<void>;
+    notify(service: string, characteristic: string, cb: (data: Uint8Array) => void, options?: DeliveryOptions): boolean;
+    notifyBatched(service: string, characteristic: string, options: BatchOptions, cb: (batch: BatchEntry[]) => void): boolean;
+    notifyDecoded(service: string, characteristic: string, layout: PayloadLayout, options: BatchOptions, cb: (batch: DecodedBatch) => void): boolean;
+    notifyShared(service: string, characteristic: string, ring: Int32Array, options?: SharedNotifyOptions): boolean;
+    indicate(service: string, characteristic: string, cb: (data: Uint8Array) => void, options?: DeliveryOptions): boolean;
+    /** Removes the subscriber listening with cb, or every subscriber without it. */
+    unsubscribe(service: string, characteristic: string, cb?: SubscriptionListener): boolean;
+    attribute(service: string, characteristic: string, descriptor?: string): Attribute;
+    subscriptionStats(service: string, characteristic: string): SubscriptionStats | undefined;
     readDescriptor(service: string, characteristic: string, descriptor: string): Uint8Array;
+    readDescriptorAsync(service: string, characteristic: string, descriptor: string): Promise<Uint8Array>;
     writeDescriptor(service: string, characteristic: string, descriptor: string, data: Uint8Array): boolean;
+    writeDescriptorAsync(service: string, characteristic: string, descriptor: string, data: Uint8Array): Promise<void>;
     setCallbackOnConnected(cb: () => void): boolean;
     setCallbackOnDisconnected(cb: () => void): boolean;
 }
 
+/** Per peripheral coalescing of scan updates. */
+export interface ScanUpdateOptions extends DeliveryOptions {
+    /** Deliver only the latest update for each peripheral every window milliseconds. */
+    window?: number;
+    /** Drop updates whose RSSI is within this many dBm of the last delivered one. */
+    rssiDelta?: number;
+}
+
+/** Scan filter applied natively before peripherals reach JS, set criteria must all match. */
+export interface ScanFilter {
+    services?: string[];
+    namePrefixes?: string[];
+    manufacturerIds?: number[];
+    addresses?: string[];
+    /** Minimum RSSI in dBm. */
+    rssi?: number;
+    /** Report each address at most once per scan on each callback. */
+    dedupe?: boolean;
+}
+
 /** SimpleBLE Adapter. */
 export interface Adapter {
     identifier: string;
@@ -99,14 +250,128 @@ export interface Adapter {
     peripherals: Peripheral[];
     pairedPeripherals: Peripheral[];
     scanFor(ms: number): boolean;
+    /** Scans for `ms` off the JS thread, found and updated callbacks fire as usual. `scanStop()` ends it early and the promise resolves. */
+    scanForAsync(ms: number): Promise<void>;
+    /** Current scan results packed into one buffer, decode with `ScanRecords`. */
+    scanResults(): ArrayBuffer;
     scanStart(): boolean;
     scanStop(): boolean;
     setCallbackOnScanStart(cb: () => void): boolean;
     setCallbackOnScanStop(cb: () => void): boolean;
-    setCallbackOnScanUpdated(cb: (peripheral: Peripheral) => void): boolean;
-    setCallbackOnScanFound(cb: (peripheral: Peripheral) => void): boolean;
+    setCallbackOnScanUpdated(cb: (peripheral: Peripheral) => void, options?: ScanUpdateOptions): boolean;
+    setCallbackOnScanFound(cb: (peripheral: Peripheral) => void, options?: DeliveryOptions): boolean;
+    setScanFilter(filter?: ScanFilter | null): boolean;
+    scanStats(): { foundDropped: number, updatedDropped: number, foundFiltered: number, updatedFiltered: number, updatedSuppressed: number };
+    /** Stops scanning and frees the native adapter, this wrapper must not be used again and `getAdapters()` hands out a new one. */
     release(): void;
 }
 
+/** Simulated descriptor. */
+export interface SimulatedDescriptor {
+    uuid: string;
+    value?: Uint8Array;
+}
+
+/** Simulated characteristic, readable and writable unless disabled. */
+export interface SimulatedCharacteristic {
+    uuid: string;
+    canRead?: boolean;
+    canWriteRequest?: boolean;
+    canWriteCommand?: boolean;
+    canNotify?: boolean;
+    canIndicate?: boolean;
+    value?: Uint8Array;
+    descriptors?: SimulatedDescriptor[];
+    /** While subscribed, send a payload every this many milliseconds, otherwise echo writes. Payloads start with a uint32 sequence number then a float64 send time in milliseconds since the epoch, both little endian */
+    notifyInterval?: number;
+    /** Length of sequence numbered payloads (default 20) */
+    notifyLength?: number;
+}
+
+/** Simulated service. */
+export interface SimulatedService {
+    uuid: string;
+    /** Service data, when advertised */
+    data?: Uint8Array;
+    characteristics?: SimulatedCharacteristic[];
+}
+
+/** Simulated advertiser and GATT server, latencies and intervals are in milliseconds. */
+export interface SimulatedPeripheral {
+    /** Create this many peripherals, numbered after the identifier with consecutive addresses */
+    count?: number;
+    identifier?: string;
+    address?: string;
+    addressType?: AddressType;
+    rssi?: number;
+    txPower?: number;
+    mtu?: number;
+    connectable?: boolean;
+    paired?: boolean;
+    manufacturerData?: Array<{ id: number, data: Uint8Array }>;
+    advertisedServices?: SimulatedService[];
+    services?: SimulatedService[];
+    advertisingInterval?: number;
+    connectLatency?: number;
+    readLatency?: number;
+    writeLatency?: number;
+    /** Drop the link this long after connecting */
+    disconnectAfter?: number;
+    /** Fail this many connection attempts before succeeding */
+    connectFailures?: number;
+}
+
+/** Simulated world. */
+export interface SimulatorConfig {
+    adapters?: number;
+    /** Seed for advertising jitter */
+    seed?: number;
+    peripherals?: SimulatedPeripheral[];
+}
+
+/** Scripting for the simulated backend. */
+export interface Simulator {
+    /** Replaces the simulated world, dropping existing connections. */
+    configure(config: SimulatorConfig): void;
+    /** Drops the connection to a peripheral as if the link was lost, false if it isn't connected. */
+    disconnect(address: string): boolean;
+}
+
+/** Durations in microseconds, percentiles are the upper bounds of power of two buckets. */
+export interface Histogram {
+    count: number;
+    mean: number;
+    p50: number;
+    p99: number;
+    max: number;
+}
+
+/** Native counters for one adapter or peripheral, identified by its address. */
+export interface EntityMetrics {
+    id: string;
+    /** Events received from SimpleBLE, before filtering */
+    received: number;
+    /** Events passed to JS callbacks */
+    delivered: number;
+    /** Events queued for JS when the last drain ran, and the most seen */
+    queueDepth: number;
+    queueDepthMax: number;
+    /** Delay from requesting a drain to it running on the JS thread */
+    dispatchLatency: Histogram;
+    /** Durations of connects, disconnects, reads and writes */
+    gatt: Histogram & { operations: number, failures: number };
+}
+
+/** Metrics of live adapters and peripherals, peripherals appear after their first GATT operation or subscription. */
+export interface Metrics {
+    /** False when built with SIMPLEBLE_NODE_METRICS off */
+    enabled: boolean;
+    adapters: EntityMetrics[];
+    peripherals: EntityMetrics[];
+}
+
 export declare function getAdapters(): Adapter[];
 export declare function isEnabled(): boolean;
+export declare function getMetrics(): Metrics;
+/** Only present when built with SIMPLEBLE_NODE_SIMULATOR. */
+export declare const simulator: Simulator | undefined;
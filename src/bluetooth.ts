@@ -53,9 +53,31 @@ export interface BluetoothOptions {
     referringDevice?: BluetoothDevice;
 
     /**
-     * An optional index of bluetooth adapter to use
+     * An optional index of bluetooth adapter to use, by default every adapter scans and connections go through the least loaded
      */
     adapterIndex?: number;
+
+    /**
+     * Optionally batch notifications natively, flushing after `count` notifications or `interval` milliseconds.
+     * Reduces per-packet overhead for high rate characteristics
+     */
+    notificationBatch?: {
+        count?: number;
+        interval?: number;
+    };
+
+    /**
+     * Optionally keep links open after `disconnect()` so the next `connect()` skips connection setup.
+     * Links lost while connected are reconnected with exponential backoff and their notifications restored
+     */
+    connectionPool?: {
+        size?: number;
+        idleTimeout?: number;
+        reconnect?: boolean;
+        reconnectDelay?: number;
+        maxReconnectDelay?: number;
+        reconnectAttempts?: number;
+    };
 }
 
 /**
@@ -100,6 +122,14 @@ class BluetoothImpl extends EventTarget implements Bluetooth {
         if (typeof options.adapterIndex === 'number') {
             adapter.useAdapter(options.adapterIndex);
         }
+
+        if (options.notificationBatch) {
+            adapter.useNotificationBatching(options.notificationBatch);
+        }
+
+        if (options.connectionPool) {
+            adapter.useConnectionPool(options.connectionPool);
+        }
     }
 
     private _oncharacteristicvaluechanged: ((ev: Event) => void) | undefined;
@@ -97,6 +97,11 @@ class BluetoothRemoteGATTCharacteristicImpl extends EventTarget implements Bluet
         this._value = init.value;
     }
 
+    // Stable, so starting twice is one subscriber and one stop ends it
+    private notifyFn = (dataView: DataView) => {
+        this.setValue(dataView, true);
+    };
+
     private setValue(value?: DataView, emit?: boolean) {
         if (value) {
             this._value = value;
@@ -215,9 +220,7 @@ class BluetoothRemoteGATTCharacteristicImpl extends EventTarget implements Bluet
             throw new Error('startNotifications error: device not connected');
         }
 
-        await adapter.enableNotify(this._handle, dataView => {
-            this.setValue(dataView, true);
-        });
+        await adapter.enableNotify(this._handle, this.notifyFn);
 
         return this;
     }
@@ -231,7 +234,7 @@ class BluetoothRemoteGATTCharacteristicImpl extends EventTarget implements Bluet
             throw new Error('stopNotifications error: device not connected');
         }
 
-        await adapter.disableNotify(this._handle);
+        await adapter.disableNotify(this._handle, this.notifyFn);
         return this;
     }
 }
@@ -0,0 +1,670 @@
+const assert = require('assert');
+const { Worker } = require('worker_threads');
+const Bluetooth = require('../').Bluetooth;
+const { getAdapters, getMetrics, simulator } = require('../dist/adapters/simpleble');
+const { createSharedRing } = require('../dist/adapters/shared-ring');
+const { ConnectionPool } = require('../dist/adapters/connection-pool');
+const { ScanRecords } = require('../dist/adapters/scan-records');
+
+const HEART_RATE = '0000180d-0000-1000-8000-00805f9b34fb';
+const MEASUREMENT = '00002a37-0000-1000-8000-00805f9b34fb';
+const CONTROL = '00002a39-0000-1000-8000-00805f9b34fb';
+const CCCD = '00002902-0000-1000-8000-00805f9b34fb';
+const USER_DESCRIPTION = '00002901-0000-1000-8000-00805f9b34fb';
+const EDDYSTONE = '0000feaa-0000-1000-8000-00805f9b34fb';
+const MISSING = '0000ffff-0000-1000-8000-00805f9b34fb';
+const ADDRESS = 'C0:FF:EE:00:00:01';
+const BEACONS = ['C0:FF:EE:00:01:00', 'C0:FF:EE:00:01:01', 'C0:FF:EE:00:01:02'];
+
+const sleep = ms => new Promise(resolve => setTimeout(resolve, ms));
+// Blocks the event loop so native deliveries queue up
+const stall = ms => {
+    const end = Date.now() + ms;
+    while (Date.now() < end);
+};
+const sequenceOf = data => new DataView(data.buffer, data.byteOffset, data.byteLength).getUint32(0, true);
+
+// Only runs against a build with `yarn build:sim`
+(simulator ? describe : describe.skip)('simulator', () => {
+    let device;
+
+    before(async () => {
+        simulator.configure({
+            adapters: 2,
+            peripherals: [{
+                identifier: 'Simulated HRM',
+                address: ADDRESS,
+                advertisingInterval: 20,
+                advertisedServices: [{ uuid: HEART_RATE }],
+                services: [{
+                    uuid: HEART_RATE,
+                    characteristics: [
+                        { uuid: MEASUREMENT, canNotify: true, notifyInterval: 10, value: new Uint8Array([0, 60]) },
+                        { uuid: CONTROL, canNotify: true, descriptors: [{ uuid: USER_DESCRIPTION, value: new Uint8Array([0x43, 0x74, 0x6c]) }] }
+                    ]
+                }]
+            }, {
+                count: BEACONS.length,
+                identifier: 'Simulated Beacon',
+                address: BEACONS[0],
+                rssi: -90,
+                connectable: false,
+                advertisingInterval: 20,
+                manufacturerData: [{ id: 0x0059, data: new Uint8Array([1]) }],
+                advertisedServices: [{ uuid: EDDYSTONE, data: new Uint8Array([0x10, 0x00, 0x2a]) }]
+            }]
+        });
+
+        const customBluetooth = new Bluetooth({ scanTime: 2 });
+        device = await customBluetooth.requestDevice({
+            filters: [{ services: [HEART_RATE] }]
+        });
+    });
+
+    afterEach(async () => {
+        if (device.gatt.connected) {
+            await device.gatt.disconnect();
+        }
+    });
+
+    // The native peripheral behind the connected device
+    const connectedPeripheral = async () => {
+        await device.gatt.connect();
+        return getAdapters()
+            .map(adapter => adapter.peripherals.find(p => p.address === ADDRESS && p.connected))
+            .find(p => p);
+    };
+
+    it('should find the simulated device', () => {
+        assert.equal(device.name, 'Simulated HRM');
+    });
+
+    it('should return the same adapters on every call', () => {
+        const adapters = getAdapters();
+        assert.equal(adapters.length, 2);
+        assert.deepEqual(getAdapters(), adapters);
+        assert.equal(getAdapters()[1], adapters[1]);
+    });
+
+    it('should return the same peripheral for a device', () => {
+        const adapter = getAdapters()[0];
+        const peripheral = adapter.peripherals.find(p => p.address === ADDRESS);
+        assert.ok(peripheral);
+        assert.equal(adapter.peripherals.find(p => p.address === ADDRESS), peripheral);
+    });
+
+    it('should end an async scan early when stopped', async () => {
+        const adapter = getAdapters()[0];
+        const start = Date.now();
+        adapter.setCallbackOnScanFound(peripheral => {
+            if (peripheral.address === ADDRESS) {
+                adapter.scanStop();
+            }
+        });
+        await adapter.scanForAsync(10000);
+        assert.ok(Date.now() - start < 5000);
+        assert.equal(adapter.active, false);
+    });
+
+    // Addresses reported on the first adapter during a scan with the filter set
+    const scanned = async filter => {
+        const adapter = getAdapters()[0];
+        const found = new Set();
+        const updated = [];
+        adapter.setScanFilter(filter);
+        adapter.setCallbackOnScanFound(peripheral => found.add(peripheral.address));
+        adapter.setCallbackOnScanUpdated(peripheral => updated.push(peripheral.address));
+        try {
+            await adapter.scanForAsync(300);
+            await sleep(20);
+        } finally {
+            adapter.setScanFilter(null);
+        }
+        return { found: Array.from(found).sort(), updated };
+    };
+
+    it('should filter scan results natively', async () => {
+        const before = getAdapters()[0].scanStats().foundFiltered;
+        assert.deepEqual((await scanned({ namePrefixes: ['Simulated B'] })).found, BEACONS);
+        assert.deepEqual((await scanned({ manufacturerIds: [0x0059] })).found, BEACONS);
+        assert.deepEqual((await scanned({ services: [HEART_RATE] })).found, [ADDRESS]);
+        assert.deepEqual((await scanned({ rssi: -75 })).found, [ADDRESS]);
+        assert.deepEqual((await scanned({ addresses: [BEACONS[1]] })).found, [BEACONS[1]]);
+        // Criteria must all match
+        assert.deepEqual((await scanned({ services: [HEART_RATE], manufacturerIds: [0x0059] })).found, []);
+        assert.ok(getAdapters()[0].scanStats().foundFiltered > before);
+    });
+
+    it('should report each address once per scan when deduplicating', async () => {
+        const { updated } = await scanned({ dedupe: true });
+        assert.ok(updated.length > 0);
+        assert.equal(new Set(updated).size, updated.length);
+    });
+
+    // Updates delivered per address on the first adapter during a scan
+    const updatesWith = async options => {
+        const adapter = getAdapters()[0];
+        const counts = new Map();
+        adapter.setCallbackOnScanFound(() => undefined);
+        adapter.setCallbackOnScanUpdated(peripheral => counts.set(peripheral.address, (counts.get(peripheral.address) || 0) + 1), options);
+        await adapter.scanForAsync(500);
+        await sleep(20);
+        return { counts, suppressed: adapter.scanStats().updatedSuppressed };
+    };
+
+    it('should coalesce scan updates within a window', async () => {
+        const { counts, suppressed } = await updatesWith({ window: 100 });
+        // Beacons advertise every 20 ms, only the latest in each window gets through
+        for (const address of BEACONS) {
+            assert.ok(counts.get(address) > 0);
+            assert.ok(counts.get(address) <= 7);
+        }
+        assert.ok(suppressed > 0);
+    });
+
+    it('should suppress scan updates within the RSSI delta', async () => {
+        const { counts, suppressed } = await updatesWith({ rssiDelta: 10 });
+        // Jitter is a few dB, so only the first update per address gets through
+        for (const address of BEACONS) {
+            assert.equal(counts.get(address), 1);
+        }
+        assert.ok(suppressed > 0);
+    });
+
+    it('should decode packed scan results', async () => {
+        const adapter = getAdapters()[0];
+        adapter.setCallbackOnScanFound(() => undefined);
+        await adapter.scanForAsync(200);
+
+        const records = new ScanRecords(adapter.scanResults());
+        const record = Array.from(records).find(r => r.address === ADDRESS);
+        assert.ok(record);
+        assert.equal(record.identifier, 'Simulated HRM');
+        assert.equal(record.connectable, true);
+        assert.deepEqual(record.services.map(service => service.uuid), [HEART_RATE]);
+        assert.equal(records.get(records.length - 1).address.length > 0, true);
+        assert.throws(() => records.get(records.length), RangeError);
+    });
+
+    it('should load in a worker thread', async () => {
+        const worker = new Worker(`
+            const { parentPort } = require('worker_threads');
+            const { getAdapters } = require(${JSON.stringify(require.resolve('../dist/adapters/simpleble'))});
+            parentPort.postMessage(getAdapters().map(adapter => adapter.address));
+        `, { eval: true });
+        const addresses = await new Promise((resolve, reject) => {
+            worker.once('message', resolve);
+            worker.once('error', reject);
+        });
+        await worker.terminate();
+        assert.deepEqual(addresses, getAdapters().map(adapter => adapter.address));
+    });
+
+    it('should read a value', async () => {
+        await device.gatt.connect();
+        const service = await device.gatt.getPrimaryService(HEART_RATE);
+        const characteristic = await service.getCharacteristic(MEASUREMENT);
+        const value = await characteristic.readValue();
+        assert.equal(value.getUint8(1), 60);
+    });
+
+    it('should echo writes as notifications', async () => {
+        await device.gatt.connect();
+        const service = await device.gatt.getPrimaryService(HEART_RATE);
+        const characteristic = await service.getCharacteristic(CONTROL);
+        await characteristic.startNotifications();
+
+        const echoed = new Promise(resolve => {
+            characteristic.addEventListener('characteristicvaluechanged', event => resolve(event.target.value));
+        });
+        await characteristic.writeValueWithResponse(new Uint8Array([5]));
+        assert.equal((await echoed).getUint8(0), 5);
+    });
+
+    it('should run queued GATT operations in order', async () => {
+        const peripheral = await connectedPeripheral();
+        const order = [];
+        const pending = [];
+        // Nothing is awaited, each read must see the write queued just before it
+        for (let i = 1; i <= 10; i++) {
+            pending.push(peripheral.writeRequestAsync(HEART_RATE, CONTROL, new Uint8Array([i])).then(() => order.push(`write ${i}`)));
+            pending.push(peripheral.readAsync(HEART_RATE, CONTROL).then(data => order.push(`read ${data[0]}`)));
+        }
+        await Promise.all(pending);
+
+        const expected = [];
+        for (let i = 1; i <= 10; i++) {
+            expected.push(`write ${i}`, `read ${i}`);
+        }
+        assert.deepEqual(order, expected);
+    });
+
+    it('should return binary values in buffers of their own length', async () => {
+        // One allocation per value, not a view into something larger
+        const ownBuffer = (data, expected) => {
+            assert.ok(data instanceof Uint8Array);
+            assert.deepEqual(Array.from(data), expected);
+            assert.equal(data.byteOffset, 0);
+            assert.equal(data.buffer.byteLength, expected.length);
+        };
+
+        const adapter = getAdapters()[0];
+        await adapter.scanForAsync(100);
+        const beacon = adapter.peripherals.find(p => p.address === BEACONS[0]);
+        ownBuffer(beacon.manufacturerData[0x0059], [1]);
+        ownBuffer(beacon.services.find(service => service.uuid === EDDYSTONE).data, [0x10, 0x00, 0x2a]);
+
+        const peripheral = await connectedPeripheral();
+        ownBuffer(peripheral.read(HEART_RATE, MEASUREMENT), [0, 60]);
+        ownBuffer(peripheral.readDescriptor(HEART_RATE, CONTROL, USER_DESCRIPTION), [0x43, 0x74, 0x6c]);
+        ownBuffer(peripheral.attribute(HEART_RATE, CONTROL, USER_DESCRIPTION).read(), [0x43, 0x74, 0x6c]);
+    });
+
+    it('should read and write many characteristics in one call', async () => {
+        const peripheral = await connectedPeripheral();
+        const written = await peripheral.writeMany([
+            [HEART_RATE, CONTROL, new Uint8Array([3])],
+            [HEART_RATE, MISSING, new Uint8Array([4])]
+        ]);
+        assert.equal(written.length, 2);
+        assert.equal(written[0], undefined);
+        assert.ok(written[1] instanceof Error);
+
+        // A failed entry doesn't stop the ones after it
+        const read = await peripheral.readMany([[HEART_RATE, MEASUREMENT], [HEART_RATE, MISSING], [HEART_RATE, CONTROL]]);
+        assert.equal(read.length, 3);
+        assert.equal(read[0][1], 60);
+        assert.ok(read[1] instanceof Error);
+        assert.deepEqual(Array.from(read[2]), [3]);
+
+        assert.deepEqual(await peripheral.writeMany([[HEART_RATE, CONTROL, new Uint8Array([5])]], true), [undefined]);
+        assert.deepEqual(Array.from((await peripheral.readMany([[HEART_RATE, CONTROL]]))[0]), [5]);
+    });
+
+    it('should stream a large payload as chunked commands', async () => {
+        const peripheral = await connectedPeripheral();
+        // Every command is echoed, one notification per chunk
+        const chunks = [];
+        assert.equal(peripheral.notify(HEART_RATE, CONTROL, data => chunks.push(Array.from(data))), true);
+
+        const payload = new Uint8Array(200).map((_, i) => i);
+        const progress = [];
+        await peripheral.writeStream(HEART_RATE, CONTROL, payload, { chunkSize: 20, burst: 4, interval: 5 }, (written, total) => progress.push([written, total]));
+        await sleep(50);
+        peripheral.unsubscribe(HEART_RATE, CONTROL);
+
+        assert.equal(chunks.length, 10);
+        assert.ok(chunks.every(chunk => chunk.length === 20));
+        assert.deepEqual(chunks.flat(), Array.from(payload));
+        // After every burst of four and once at the end
+        assert.deepEqual(progress, [[80, 200], [160, 200], [200, 200]]);
+    });
+
+    it('should fail a stream once a refused chunk runs out of retries', async () => {
+        const peripheral = await connectedPeripheral();
+        const progress = [];
+        const start = Date.now();
+        await assert.rejects(peripheral.writeStream(HEART_RATE, MISSING, new Uint8Array(100), { retries: 2, interval: 20 }, written => progress.push(written)));
+        // Each retry waits out the interval first
+        assert.ok(Date.now() - start >= 40);
+        await sleep(20);
+        assert.deepEqual(progress, [0]);
+    });
+
+    it('should read, write and subscribe through an attribute handle', async () => {
+        const peripheral = await connectedPeripheral();
+        const control = peripheral.attribute(HEART_RATE, CONTROL);
+        assert.equal(control.service, HEART_RATE);
+        assert.equal(control.characteristic, CONTROL);
+        assert.equal(control.descriptor, undefined);
+
+        assert.equal(control.writeRequest(new Uint8Array([7])), true);
+        assert.deepEqual(Array.from(peripheral.read(HEART_RATE, CONTROL)), [7]);
+        await control.writeRequestAsync(new Uint8Array([8]));
+        assert.deepEqual(Array.from(await control.readAsync()), [8]);
+        assert.deepEqual(Array.from(control.read()), [8]);
+
+        const echoed = new Promise(resolve => control.notify(resolve));
+        assert.equal(control.writeCommand(new Uint8Array([9])), true);
+        assert.deepEqual(Array.from(await echoed), [9]);
+        assert.equal(control.unsubscribe(), true);
+        assert.equal(peripheral.subscriptionStats(HEART_RATE, CONTROL), undefined);
+    });
+
+    it('should reject subscribing through a descriptor handle', async () => {
+        const peripheral = await connectedPeripheral();
+        const descriptor = peripheral.attribute(HEART_RATE, CONTROL, CCCD);
+        assert.equal(descriptor.descriptor, CCCD);
+        assert.throws(() => descriptor.notify(() => undefined), TypeError);
+        assert.throws(() => peripheral.attribute(HEART_RATE, 0x2a39), TypeError);
+    });
+
+    it('should notify in sequence', async () => {
+        await device.gatt.connect();
+        const service = await device.gatt.getPrimaryService(HEART_RATE);
+        const characteristic = await service.getCharacteristic(MEASUREMENT);
+        await characteristic.startNotifications();
+
+        const sequence = await new Promise(resolve => {
+            const values = [];
+            characteristic.addEventListener('characteristicvaluechanged', event => {
+                values.push(event.target.value.getUint32(0, true));
+                if (values.length === 5) {
+                    resolve(values);
+                }
+            });
+        });
+        await characteristic.stopNotifications();
+
+        for (let i = 1; i < sequence.length; i++) {
+            assert.equal(sequence[i], sequence[i - 1] + 1);
+        }
+    });
+
+    it('should hand each notification its own buffer', async () => {
+        const peripheral = await connectedPeripheral();
+        const received = [];
+        assert.equal(peripheral.notify(HEART_RATE, MEASUREMENT, data => received.push(data)), true);
+        await sleep(100);
+        peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+
+        assert.ok(received.length >= 3);
+        for (let i = 0; i < received.length; i++) {
+            // Exactly the payload, not a view into a shared slab
+            assert.equal(received[i].byteOffset, 0);
+            assert.equal(received[i].byteLength, 20);
+            assert.equal(received[i].buffer.byteLength, 20);
+            if (i > 0) {
+                assert.notEqual(received[i].buffer, received[i - 1].buffer);
+                assert.equal(sequenceOf(received[i]), sequenceOf(received[i - 1]) + 1);
+            }
+        }
+    });
+
+    it('should stop notifications started twice with one stop', async () => {
+        await device.gatt.connect();
+        // The device may have connected through either adapter's peripheral
+        const subscribed = () => getAdapters()
+            .map(adapter => adapter.peripherals.find(p => p.address === ADDRESS))
+            .some(p => p && p.subscriptionStats(HEART_RATE, MEASUREMENT) !== undefined);
+
+        const service = await device.gatt.getPrimaryService(HEART_RATE);
+        const characteristic = await service.getCharacteristic(MEASUREMENT);
+        await characteristic.startNotifications();
+        await characteristic.startNotifications();
+        assert.equal(subscribed(), true);
+
+        await characteristic.stopNotifications();
+        assert.equal(subscribed(), false);
+    });
+
+    it('should keep a subscription until its last subscriber leaves', async () => {
+        const peripheral = await connectedPeripheral();
+        const first = [];
+        const second = [];
+        const onFirst = data => first.push(sequenceOf(data));
+        const onSecond = data => second.push(sequenceOf(data));
+        assert.equal(peripheral.notify(HEART_RATE, MEASUREMENT, onFirst), true);
+        assert.equal(peripheral.notify(HEART_RATE, MEASUREMENT, onSecond), true);
+        await sleep(50);
+        assert.ok(first.length > 0);
+        assert.ok(second.length > 0);
+
+        // One subscriber leaving does not end the other's notifications
+        assert.equal(peripheral.unsubscribe(HEART_RATE, MEASUREMENT, onFirst), true);
+        const received = second.length;
+        await sleep(50);
+        assert.ok(second.length > received);
+        assert.notEqual(peripheral.subscriptionStats(HEART_RATE, MEASUREMENT), undefined);
+
+        assert.equal(peripheral.unsubscribe(HEART_RATE, MEASUREMENT, onSecond), true);
+        assert.equal(peripheral.subscriptionStats(HEART_RATE, MEASUREMENT), undefined);
+    });
+
+    it('should refuse a subscription in another mode', async () => {
+        const peripheral = await connectedPeripheral();
+        const values = [];
+        const layout = { fields: [{ name: 'sequence', type: 'uint32' }], stride: 20 };
+        assert.equal(peripheral.notify(HEART_RATE, MEASUREMENT, data => values.push(sequenceOf(data))), true);
+        assert.throws(() => peripheral.notifyBatched(HEART_RATE, MEASUREMENT, { count: 4 }, () => undefined), TypeError);
+        assert.throws(() => peripheral.notifyDecoded(HEART_RATE, MEASUREMENT, layout, { count: 4 }, () => undefined), TypeError);
+        assert.throws(() => peripheral.attribute(HEART_RATE, MEASUREMENT).notifyBatched({ count: 4 }, () => undefined), TypeError);
+
+        // The first subscriber keeps its notifications
+        await sleep(50);
+        const received = values.length;
+        assert.ok(received > 0);
+        await sleep(50);
+        assert.ok(values.length > received);
+
+        assert.equal(peripheral.unsubscribe(HEART_RATE, MEASUREMENT), true);
+        const batches = [];
+        assert.equal(peripheral.notifyBatched(HEART_RATE, MEASUREMENT, { count: 4 }, batch => batches.push(batch)), true);
+        await sleep(50);
+        peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+        assert.ok(batches.length > 0);
+    });
+
+    it('should count GATT operations and deliveries in the metrics', async () => {
+        const peripheral = await connectedPeripheral();
+        // Each adapter keeps its own peripheral for the device
+        const totals = () => getMetrics().peripherals
+            .filter(metrics => metrics.id === ADDRESS)
+            .reduce((sum, metrics) => ({
+                operations: sum.operations + metrics.gatt.operations,
+                failures: sum.failures + metrics.gatt.failures,
+                delivered: sum.delivered + metrics.delivered
+            }), { operations: 0, failures: 0, delivered: 0 });
+
+        if (!getMetrics().enabled) {
+            assert.deepEqual(getMetrics().peripherals, []);
+            return;
+        }
+
+        const before = totals();
+        assert.ok(peripheral.read(HEART_RATE, MEASUREMENT));
+        await peripheral.readAsync(HEART_RATE, MEASUREMENT);
+        assert.equal(peripheral.read(HEART_RATE, MISSING), undefined);
+
+        const values = [];
+        peripheral.notify(HEART_RATE, MEASUREMENT, data => values.push(data));
+        await sleep(100);
+        peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+
+        const after = totals();
+        assert.ok(after.operations >= before.operations + 3);
+        assert.ok(after.failures >= before.failures + 1);
+        assert.ok(values.length > 0);
+        assert.ok(after.delivered - before.delivered >= values.length);
+
+        const metrics = getMetrics();
+        assert.ok(metrics.adapters.some(adapter => adapter.id === getAdapters()[0].address));
+        for (const entry of metrics.peripherals.filter(metrics => metrics.id === ADDRESS && metrics.gatt.count > 0)) {
+            // Percentiles are power of two bucket bounds, at most double the value
+            assert.ok(entry.gatt.p50 <= entry.gatt.p99);
+            assert.ok(entry.gatt.p99 <= Math.max(2 * entry.gatt.max, 1));
+        }
+    });
+
+    it('should only list metrics of its own environment', async () => {
+        if (!getMetrics().enabled) {
+            return;
+        }
+
+        await connectedPeripheral();
+        assert.ok(getMetrics().peripherals.length > 0);
+        const worker = new Worker(`
+            const { parentPort } = require('worker_threads');
+            const { getMetrics } = require(${JSON.stringify(require.resolve('../dist/adapters/simpleble'))});
+            parentPort.postMessage(getMetrics());
+        `, { eval: true });
+        const metrics = await new Promise((resolve, reject) => {
+            worker.once('message', resolve);
+            worker.once('error', reject);
+        });
+        await worker.terminate();
+        assert.deepEqual(metrics.adapters, []);
+        assert.deepEqual(metrics.peripherals, []);
+    });
+
+    it('should reject a batch count above the capacity', () => {
+        const peripheral = getAdapters()[0].peripherals.find(p => p.address === ADDRESS);
+        assert.throws(() => peripheral.notifyBatched(HEART_RATE, MEASUREMENT, { count: 8, capacity: 4 }, () => undefined), RangeError);
+        assert.throws(() => peripheral.notifyBatched(HEART_RATE, MEASUREMENT, { count: 2048 }, () => undefined), RangeError);
+    });
+
+    const overflowed = async (overflow, stallMs) => {
+        const peripheral = await connectedPeripheral();
+        const values = [];
+        assert.equal(peripheral.notify(HEART_RATE, MEASUREMENT, data => values.push(sequenceOf(data)), { capacity: 2, overflow }), true);
+        stall(stallMs);
+        await sleep(50);
+        const stats = peripheral.subscriptionStats(HEART_RATE, MEASUREMENT);
+        peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+        return { values, stats };
+    };
+
+    it('should drop the oldest notifications when full', async () => {
+        const { values, stats } = await overflowed('drop-oldest', 200);
+        assert.ok(stats.dropped > 0);
+        // Only the newest survived the stall
+        assert.ok(values[0] >= 5);
+    });
+
+    it('should drop the newest notifications when full', async () => {
+        const { values, stats } = await overflowed('drop-newest', 200);
+        assert.ok(stats.dropped > 0);
+        assert.deepEqual(values.slice(0, 2), [0, 1]);
+        assert.ok(values[2] > 2);
+    });
+
+    it('should block the producer when full', async () => {
+        const { values, stats } = await overflowed('block', 50);
+        assert.equal(stats.dropped, 0);
+        for (let i = 0; i < values.length; i++) {
+            assert.equal(values[i], i);
+        }
+    });
+
+    it('should give up blocking after the block timeout', async () => {
+        const peripheral = await connectedPeripheral();
+        const values = [];
+        peripheral.notify(HEART_RATE, MEASUREMENT, data => values.push(sequenceOf(data)), { capacity: 2, overflow: 'block', blockTimeout: 20 });
+        stall(300);
+        await sleep(50);
+        const stats = peripheral.subscriptionStats(HEART_RATE, MEASUREMENT);
+        peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+
+        assert.ok(stats.dropped > 0);
+        assert.deepEqual(values.slice(0, 2), [0, 1]);
+    });
+
+    it('should decode notifications into columns', async () => {
+        const peripheral = await connectedPeripheral();
+
+        const layout = { fields: [{ name: 'sequence', type: 'uint32' }, { name: 'sent', type: 'float64' }], stride: 20 };
+        const batch = await new Promise(resolve => {
+            assert.equal(peripheral.notifyDecoded(HEART_RATE, MEASUREMENT, layout, { count: 5 }, resolve), true);
+        });
+        peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+
+        const { sequence, sent } = batch.columns;
+        assert.ok(sequence instanceof Uint32Array);
+        assert.ok(sent instanceof Float64Array);
+        assert.ok(batch.count >= 5);
+        assert.equal(sequence.length, batch.count);
+        assert.equal(batch.timestamp.length, batch.count);
+        for (let i = 1; i < batch.count; i++) {
+            assert.equal(sequence[i], sequence[i - 1] + 1);
+            assert.ok(sent[i] <= batch.timestamp[i]);
+        }
+    });
+
+    it('should deliver notifications to a worker through a shared ring', async () => {
+        const peripheral = await connectedPeripheral();
+        const ring = createSharedRing(1024);
+
+        const worker = new Worker(`
+            const { parentPort, workerData } = require('worker_threads');
+            const { SharedRingReader } = require(${JSON.stringify(require.resolve('../dist/adapters/shared-ring'))});
+            const reader = new SharedRingReader(workerData);
+            const values = [];
+            while (values.length < 5 && reader.wait(5000)) {
+                for (let record = reader.read(); record; record = reader.read()) {
+                    values.push(new DataView(record.data.buffer).getUint32(0, true));
+                }
+            }
+            parentPort.postMessage(values);
+        `, { eval: true, workerData: ring });
+        assert.equal(peripheral.notifyShared(HEART_RATE, MEASUREMENT, ring), true);
+
+        const sequence = await new Promise((resolve, reject) => {
+            worker.once('message', resolve);
+            worker.once('error', reject);
+        });
+        peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+        await worker.terminate();
+
+        assert.ok(sequence.length >= 5);
+        for (let i = 1; i < sequence.length; i++) {
+            assert.equal(sequence[i], sequence[i - 1] + 1);
+        }
+    });
+
+    it('should reconnect a pooled link and restore its notifications', async () => {
+        const peripheral = getAdapters()[0].peripherals.find(p => p.address === ADDRESS);
+        const pool = new ConnectionPool({ reconnectDelay: 200 });
+        const values = [];
+        const onValue = data => values.push(sequenceOf(data));
+        let restored = 0;
+        try {
+            await pool.acquire(peripheral);
+            assert.equal(peripheral.notify(HEART_RATE, MEASUREMENT, onValue), true);
+            pool.track(peripheral, MEASUREMENT, () => {
+                restored++;
+                peripheral.unsubscribe(HEART_RATE, MEASUREMENT);
+                return peripheral.notify(HEART_RATE, MEASUREMENT, onValue);
+            });
+
+            assert.equal(simulator.disconnect(ADDRESS), true);
+            await sleep(20);
+            assert.equal(peripheral.connected, false);
+
+            // Brings the pending reconnect forward instead of racing it
+            await pool.acquire(peripheral);
+            assert.equal(peripheral.connected, true);
+            const received = values.length;
+            await sleep(300);
+            assert.equal(restored, 1);
+            assert.ok(values.length > received);
+        } finally {
+            pool.close(peripheral);
+        }
+    });
+
+    it('should have disconnect event on link loss', done => {
+        const disconnect = () => {
+            device.removeEventListener('gattserverdisconnected', disconnect);
+            assert.equal(device.gatt.connected, false);
+            done();
+        };
+
+        device.addEventListener('gattserverdisconnected', disconnect);
+        device.gatt.connect()
+        .then(() => assert.equal(simulator.disconnect(ADDRESS), true));
+    });
+
+    // Last, the released adapter's peripherals and sightings go stale
+    it('should hand out a new adapter once one is released', () => {
+        const released = getAdapters()[1];
+        const address = released.address;
+        released.release();
+
+        const adapters = getAdapters();
+        assert.equal(adapters.length, 2);
+        assert.notEqual(adapters[1], released);
+        assert.equal(adapters[1].address, address);
+        assert.equal(getAdapters()[1], adapters[1]);
+        assert.ok(Array.isArray(adapters[1].peripherals));
+    });
+});